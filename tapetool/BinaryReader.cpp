@@ -27,9 +27,9 @@ bool CBinaryReader::Open(const char* filename, Resolution res)
 		return false;
 	}
 
-	fseek(_file, 0, SEEK_END);
-	_length = ftell(_file);
-	fseek(_file, 0, SEEK_SET);
+	fseek64(_file, 0, SEEK_END);
+	_length = ftell64(_file);
+	fseek64(_file, 0, SEEK_SET);
 		
 	// Work out data format from extension
 	_dataFormat = strrchr(filename, '.');
@@ -60,9 +60,9 @@ bool CBinaryReader::IsWaveFile()
 	return false;
 }
 
-int CBinaryReader::CurrentPosition()
+int64 CBinaryReader::CurrentPosition()
 {
-	return ftell(_file);
+	return ftell64(_file);
 }
 
 int CBinaryReader::ReadCycleLen()
@@ -77,16 +77,16 @@ char CBinaryReader::ReadCycleKind()
 	return 0;
 }
 
-void CBinaryReader::Seek(int position)
+void CBinaryReader::Seek(int64 position)
 {
-	fseek(_file, position, SEEK_SET);
+	fseek64(_file, position, SEEK_SET);
 }
 
-char* CBinaryReader::FormatDuration(int duration)
+char* CBinaryReader::FormatDuration(int64 duration)
 {
 	static char sz[512];
 
-	sprintf(sz, "%i bytes", duration);
+	sprintf(sz, "%lli bytes", duration);
 	return sz;
 }
 
@@ -97,7 +97,7 @@ int CBinaryReader::LastCycleLen()
 
 bool CBinaryReader::SyncToBit(bool verbose)
 {
-	return ftell(_file) < _length;
+	return ftell64(_file) < _length;
 }
 
 int CBinaryReader::ReadBit(bool verbose)
@@ -108,7 +108,7 @@ int CBinaryReader::ReadBit(bool verbose)
 
 bool CBinaryReader::SyncToByte(bool verbose)
 {
-	return ftell(_file) < _length;
+	return ftell64(_file) < _length;
 }
 
 int CBinaryReader::ReadByte(bool verbose)
@@ -18,11 +18,11 @@ public:
 	virtual Resolution GetResolution();
 	virtual void Delete();
 	virtual bool IsWaveFile();
-	virtual int CurrentPosition();
+	virtual int64 CurrentPosition();
 	virtual int ReadCycleLen();
 	virtual char ReadCycleKind();
-	virtual void Seek(int position);
-	virtual char* FormatDuration(int duration);
+	virtual void Seek(int64 position);
+	virtual char* FormatDuration(int64 duration);
 	virtual int LastCycleLen();
 	virtual bool SyncToBit(bool verbose);
 	virtual int ReadBit(bool verbose = true);
@@ -30,7 +30,7 @@ public:
 	virtual int ReadByte(bool verbose=true);
 
 	FILE* _file;
-	int _length;
+	int64 _length;
 	const char* _dataFormat;
 };
 
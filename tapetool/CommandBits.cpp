@@ -5,6 +5,8 @@
 
 #include "Context.h"
 #include "CommandBits.h"
+#include "TextOutput.h"
+#include "DumpFile.h"
 
 // Command handler for dumping bits
 int CCommandBits::Process()
@@ -23,7 +25,7 @@ int CCommandBits::Process()
 	int index = 0;
 	while (true)
 	{
-		int savePos = file->CurrentPosition();
+		int64 savePos = file->CurrentPosition();
 
 		// Read a bit
 		int bit = file->ReadBit();
@@ -33,13 +35,15 @@ int CCommandBits::Process()
 		{
 			printf("\n\n");
 
-			printf("[last bit ended at %i]\n", savePos);
+			printf("[last bit ended at %lli]\n", savePos);
+			if (dumpFile)
+				dumpFile->AddError(savePos);
 
 			file->Seek(savePos);
 			if (!file->SyncToBit(showSyncData))
 				break;
 
-			int skipped = file->CurrentPosition() - savePos;
+			int64 skipped = file->CurrentPosition() - savePos;
 			printf("\n[skipped %s while re-syncing]\n", file->FormatDuration(skipped));
 
 			printf("\n");
@@ -52,14 +56,16 @@ int CCommandBits::Process()
 		if ((index++ % perline)==0)
 		{
 			if (showPositionInfo)
-				printf("\n[@%12i] ", savePos);
+				OutputPosition(savePos);
 			else
-				printf("\n");
+				OutputChar('\n');
 		}
 
-		printf("%i", bit);
+		OutputBit(bit);
 		if (renderFile)
 			machine->RenderBit(renderFile, bit);
+		if (dumpFile)
+			dumpFile->Add(savePos, file->CurrentPosition(), bit);
 	}
 
 	printf("\n\n");
@@ -16,6 +16,7 @@ public:
 	virtual int Process();
 	virtual const char* GetCommandName() { return "bits"; }
 	virtual void ShowUsage();
+	virtual bool DoesWriteBinaryDump() { return true; }
 };
 
 #endif	// __COMMANDBITS_H
@@ -5,6 +5,8 @@
 
 #include "Context.h"
 #include "CommandBytes.h"
+#include "TextOutput.h"
+#include "DumpFile.h"
 
 // Command handler for dumping bytes
 int CCommandBytes::Process()
@@ -23,7 +25,7 @@ int CCommandBytes::Process()
 	int index = 0;
 	while (true)
 	{
-		int pos = file->CurrentPosition();
+		int64 pos = file->CurrentPosition();
 
 		// Read a byte
 		int byte = file->ReadByte();
@@ -33,13 +35,15 @@ int CCommandBytes::Process()
 		{
 			printf("\n\n");
 
-			printf("[last byte ended at %i]\n", pos);
+			printf("[last byte ended at %lli]\n", pos);
+			if (dumpFile)
+				dumpFile->AddError(pos);
 
 			file->Seek(pos);
 			if (!file->SyncToByte(showSyncData))
 				break;
 
-			int skipped = file->CurrentPosition() - pos;
+			int64 skipped = file->CurrentPosition() - pos;
 			printf("\n[skipped %s while re-syncing]\n", file->FormatDuration(skipped));
 
 			printf("\n");
@@ -52,16 +56,18 @@ int CCommandBytes::Process()
 		if ((index++ % perline)==0)
 		{
 			if (showPositionInfo)
-				printf("\n[@%12i] ", pos);
+				OutputPosition(pos);
 			else
-				printf("\n");
+				OutputChar('\n');
 		}
 
-		printf("0x%.2x ", byte);
+		OutputHexByte(byte);
 		if (renderFile)
 			machine->RenderByte(renderFile, byte);
 		if (binaryFile)
 			fwrite(&byte, 1, 1, binaryFile);
+		if (dumpFile)
+			dumpFile->Add(pos, file->CurrentPosition(), byte);
 	}
 
 	printf("\n\n");
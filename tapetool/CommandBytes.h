@@ -16,6 +16,7 @@ public:
 	virtual int Process();
 	virtual const char* GetCommandName() { return "bytes"; }
 	virtual void ShowUsage();
+	virtual bool DoesWriteBinaryDump() { return true; }
 };
 
 #endif	// __COMMANDBYTES_H
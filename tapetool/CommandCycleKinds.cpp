@@ -5,6 +5,8 @@
 
 #include "Context.h"
 #include "CommandCycleKinds.h"
+#include "TextOutput.h"
+#include "DumpFile.h"
 
 // Command handler for dumping cycle kinds
 int CCommandCycleKinds::Process()
@@ -19,7 +21,7 @@ int CCommandCycleKinds::Process()
 	int index = 0;
 	while (true)
 	{
-		int pos = file->CurrentPosition();
+		int64 pos = file->CurrentPosition();
 
 		char kind = file->ReadCycleKind();
 		if (kind==0)
@@ -29,14 +31,16 @@ int CCommandCycleKinds::Process()
 		if ((index++ % perline)==0)
 		{
 			if (showPositionInfo)
-				printf("\n[@%12i] ", pos);
+				OutputPosition(pos);
 			else
-				printf("\n");
+				OutputChar('\n');
 		}
 
-		printf("%c", kind);
+		OutputChar(kind);
 		if (renderFile)
 			machine->RenderCycleKind(renderFile, kind);
+		if (dumpFile)
+			dumpFile->Add(pos, file->CurrentPosition(), kind);
 	}
 
 	printf("\n\n");
@@ -16,6 +16,7 @@ public:
 	virtual int Process();
 	virtual const char* GetCommandName() { return "cyclekinds"; }
 	virtual void ShowUsage();
+	virtual bool DoesWriteBinaryDump() { return true; }
 };
 
 #endif	// __COMMANDCYCLEKINDS_H
@@ -5,6 +5,8 @@
 
 #include "Context.h"
 #include "CommandCycles.h"
+#include "TextOutput.h"
+#include "DumpFile.h"
 
 // Command handler for dumping cycle lengths
 int CCommandCycles::Process()
@@ -22,17 +24,20 @@ int CCommandCycles::Process()
 		if ((index++ % perline)==0)
 		{
 			if (showPositionInfo)
-				printf("\n[@%12i] ", file->CurrentPosition());
+				OutputPosition(file->CurrentPosition());
 			else
-				printf("\n");
+				OutputChar('\n');
 		}
 
+		int64 pos = file->CurrentPosition();
 		int cyclelen= file->ReadCycleLen();
 		if (cyclelen<0)
 			break;
 
+		if (dumpFile)
+			dumpFile->Add(pos, file->CurrentPosition(), cyclelen);
 
-		printf("#%i ", cyclelen);
+		OutputCycleLength(cyclelen);
 	}
 
 	printf("\n\n");
@@ -17,6 +17,7 @@ public:
 	virtual bool DoesTranslateFromWaveData() { return false; }
 	virtual const char* GetCommandName() { return "cycles"; }
 	virtual void ShowUsage();
+	virtual bool DoesWriteBinaryDump() { return true; }
 };
 
 #endif	// __COMMANDCYCLES_H
@@ -32,11 +32,19 @@ int CCommandDelete::Process()
 
 	// Main loop
 	fprintf(stderr, "Copying samples...");
-	while (wave.HaveSample())
+	int samples[SAMPLE_BLOCK_SIZE];
+	samples[0] = wave.CurrentSample();
+	int count = wave.HaveSample() ? 1 : 0;
+	int64 pos = wave.CurrentPosition();
+	while (count>0)
 	{
-		if (wave.CurrentPosition()<GetStartSample() && wave.CurrentPosition()>=GetEndSample())
-			writer.RenderSample(wave.CurrentSample());
-		wave.NextSample();
+		// Render the part of this block that's kept
+		int64 from = pos < GetEndSample() ? GetEndSample() : pos;
+		int64 to = pos + count < GetStartSample() ? pos + count : GetStartSample();
+		if (from < to)
+			writer.RenderSamples(samples + (int)(from - pos), (int)(to - from));
+		pos += count;
+		count = wave.ReadSamples(samples, SAMPLE_BLOCK_SIZE);
 	}
 
 	writer.Close();
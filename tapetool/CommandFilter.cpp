@@ -33,10 +33,17 @@ int CCommandFilter::Process()
 	// Main loop
 	fprintf(stderr, "Copying samples...");
 	wave.Seek(GetStartSample());
-	while (wave.HaveSample() && wave.CurrentPosition() < GetEndSample())
+	int samples[SAMPLE_BLOCK_SIZE];
+	samples[0] = wave.CurrentSample();
+	int count = wave.HaveSample() ? 1 : 0;
+	int64 pos = wave.CurrentPosition();
+	while (count>0 && pos < GetEndSample())
 	{
-		writer.RenderSample(wave.CurrentSample());
-		wave.NextSample();
+		if (count > GetEndSample() - pos)
+			count = (int)(GetEndSample() - pos);
+		writer.RenderSamples(samples, count);
+		pos += count;
+		count = wave.ReadSamples(samples, SAMPLE_BLOCK_SIZE);
 	}
 
 	writer.Close();
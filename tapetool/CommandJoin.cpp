@@ -15,6 +15,19 @@ CCommandJoin::CCommandJoin()
 	_gap = 0;
 }
 
+// Copy all remaining samples from a wave reader to a writer
+static void CopySamples(CWaveReader& wave, CWaveWriter& writer)
+{
+	int samples[SAMPLE_BLOCK_SIZE];
+	samples[0] = wave.CurrentSample();
+	int count = wave.HaveSample() ? 1 : 0;
+	while (count>0)
+	{
+		writer.RenderSamples(samples, count);
+		count = wave.ReadSamples(samples, SAMPLE_BLOCK_SIZE);
+	}
+}
+
 // Command handler for dumping samples
 int CCommandJoin::Process()
 {
@@ -51,11 +64,7 @@ int CCommandJoin::Process()
 
 	// File 1
 	fprintf(stderr, "Copying samples from '%s'...", _inputFileName1);
-	while (wave1.HaveSample())
-	{
-		writer.RenderSample(wave1.CurrentSample());
-		wave1.NextSample();
-	}
+	CopySamples(wave1, writer);
 
 	// Render the gap
 	if (_gap!=0.0)
@@ -66,11 +75,7 @@ int CCommandJoin::Process()
 
 	// File 2
 	fprintf(stderr, "\nCopying samples from '%s'...", _inputFileName2);
-	while (wave2.HaveSample())
-	{
-		writer.RenderSample(wave2.CurrentSample());
-		wave2.NextSample();
-	}
+	CopySamples(wave2, writer);
 
 
 	writer.Close();
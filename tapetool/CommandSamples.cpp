@@ -40,7 +40,7 @@ int CCommandSamples::Process()
 		if ((index++ % perline)==0)
 		{
 			if (_showPositionInfo)
-				printf("\n[@%12i] ", wave.CurrentPosition());
+				printf("\n[@%12lli] ", wave.CurrentPosition());
 			else
 				printf("\n");
 		}
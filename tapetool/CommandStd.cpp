@@ -15,8 +15,19 @@
 #include "TapeReader.h"
 #include "TextReader.h"
 #include "BinaryReader.h"
+#include "DumpReader.h"
 #include "WaveWriter.h"
 #include "WaveWriterProfiled.h"
+#include "WaveAnalysis.h"
+#include "TextOutput.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define dup2 _dup2
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
 
 // Standard command
 CCommandStd::CCommandStd(CContext* ctx)
@@ -31,6 +42,7 @@ CCommandStd::CCommandStd(CContext* ctx)
 	leadingSilence = 2.0;
 	leadingZeros = 0;
 	autoAnalyze = true;
+	analyzeWindows = 0;
 	renderSampleRate = 24000;
 	renderSampleSize = 8;
 	renderVolume = 10;
@@ -40,17 +52,24 @@ CCommandStd::CCommandStd(CContext* ctx)
 	inputFormat = NULL;
 	instrumentRes = resNA;
 	profileFileName = NULL;
-	speedChangePos= 0x7FFFFFFF;
+	speedChangePos= SPEED_CHANGE_NONE;
 	speedChangeSpeed = 0;
 	byteWrapIndex = 0;
 	machine = NULL;
 	file = NULL;
 	renderFile = NULL;
 	binaryFile = NULL;
+	dumpFile = NULL;
 	_includeProfiledLeadIn = true;
 	_includeProfiledLeadOut = true;
 	_strict = false;
+	_viterbi = false;
+	_demod = false;
+	_workingRate = 0;
 	_fixTiming = false;
+	_useCycleIndex = true;
+	_live = false;
+	_binaryOutFileName = NULL;
 }
 
 CCommandStd::~CCommandStd()
@@ -65,6 +84,31 @@ int CCommandStd::AddSwitch(const char* arg, const char* val)
 	{
 		autoAnalyze = false;
 	}
+	else if (_strcmpi(arg, "quickanalyze")==0)
+	{
+		analyzeWindows = val==NULL ? 32 : atoi(val);
+	}
+	else if (_strcmpi(arg, "workingrate")==0)
+	{
+		_workingRate = val==NULL ? 44100 : atoi(val);
+	}
+	else if (_strcmpi(arg, "nocycleindex")==0)
+	{
+		_useCycleIndex = false;
+	}
+	else if (_strcmpi(arg, "live")==0)
+	{
+		_live = true;
+	}
+	else if (_strcmpi(arg, "binary-out")==0)
+	{
+		if (val==NULL)
+		{
+			fprintf(stderr, "--binary-out requires a file name");
+			return 7;
+		}
+		_binaryOutFileName = val;
+	}
 	else if (_strcmpi(arg, "syncinfo")==0)
 	{
 		showSyncData = true;
@@ -120,7 +164,7 @@ int CCommandStd::AddSwitch(const char* arg, const char* val)
 	}
 	else if (_strcmpi(arg, "speedchangepos")==0)
 	{
-		speedChangePos= val==NULL ? 0 : atoi(val);
+		speedChangePos= val==NULL ? 0 : atoi64(val);
 	}
 	else if (_strcmpi(arg, "speedchangespeed")==0)
 	{
@@ -166,6 +210,14 @@ int CCommandStd::AddSwitch(const char* arg, const char* val)
 	{
 		_strict = true;
 	}
+	else if (_strcmpi(arg, "viterbi")==0)
+	{
+		_viterbi = true;
+	}
+	else if (_strcmpi(arg, "demod")==0)
+	{
+		_demod = true;
+	}
 	else if (_strcmpi(arg, "fixtiming")==0)
 	{
 		_fixTiming = true;
@@ -214,6 +266,13 @@ bool CCommandStd::OpenFiles(Resolution res)
 	if (!OpenOutputFile(res))
 		return false;
 
+	// Open the binary dump file
+	if (!OpenDumpFile(res))
+		return false;
+
+	// Now stdout's final destination is known
+	InitTextOutput(_live);
+
 	// Work out the lowest level resolution we're working at
 	Resolution resInput = file->GetResolution();
 	if (resInput < res)
@@ -243,7 +302,12 @@ bool CCommandStd::OpenInputFile(Resolution res)
 	file = machine->CreateFileReader(this, ext);
 	if (file==NULL)
 	{
-		if (ext!=NULL && _stricmp(ext, ".wav")==0)
+		// "-" is a wave streamed on stdin
+		if (strcmp(_inputFileName, "-")==0)
+		{
+			file = new CTapeReader(this);
+		}
+		else if (ext!=NULL && _stricmp(ext, ".wav")==0)
 		{
 			file = new CTapeReader(this); 
 		}
@@ -251,6 +315,10 @@ bool CCommandStd::OpenInputFile(Resolution res)
 		{
 			file = new CTextReader(this);
 		}
+		else if (ext!=NULL && _stricmp(ext, DUMP_FILE_EXTENSION)==0)
+		{
+			file = new CDumpReader(this);
+		}
 		else
 		{
 			file = new CBinaryReader(this);
@@ -272,6 +340,17 @@ bool CCommandStd::OpenOutputFile(Resolution res)
 		return true;
 	}
 
+	// Wave file to stdout?  Text output goes to stderr instead
+	if (strcmp(_outputFileName, "-")==0)
+	{
+		outputExtension="wav";
+		if (!OpenRenderFile(_outputFileName))
+			return false;
+		fflush(stdout);
+		dup2(fileno(stderr), fileno(stdout));
+		return true;
+	}
+
 	// Redirect stdout to the text file
 	const char* ext = strrchr(_outputFileName, '.');
 	if (ext==NULL)
@@ -368,10 +447,40 @@ bool CCommandStd::OpenBinaryFile(const char* filename)
 	return true;
 }
 
+// Create the binary dump file
+bool CCommandStd::OpenDumpFile(Resolution res)
+{
+	if (_binaryOutFileName==NULL)
+		return true;
+
+	if (!DoesWriteBinaryDump())
+	{
+		fprintf(stderr, "--binary-out is only supported by the cycles, cyclekinds, bits and bytes commands\n");
+		return false;
+	}
+
+	dumpFile = new CDumpWriter();
+	return dumpFile->Create(_binaryOutFileName, res);
+}
 		
 // Close any open files
 void CCommandStd::CloseFiles()
 {
+	// Before the input file as it supplies the end position and cycle lengths
+	if (dumpFile!=NULL)
+	{
+		dumpFile->Close(file, GetInputFormat());
+		delete dumpFile;
+		dumpFile = NULL;
+	}
+
+	if (machine!=NULL)
+	{
+		if (showSyncData)
+			machine->ShowDecodeCacheStats();
+		machine->ResetDecodeCache();
+	}
+
 	if (file!=NULL)
 	{
 		file->Delete();
@@ -412,12 +521,40 @@ void CCommandStd::DumpByte(int byte)
 {
 	if ((byteWrapIndex!=0 && ((byteWrapIndex % (perLine==0 ? 16 : perLine))==0)))
 	{
-		printf("\n");
+		OutputChar('\n');
 	}
-	printf("0x%.2x ", byte);
+	OutputHexByte(byte);
 	byteWrapIndex++;
 }
 
+// Analyse the input wave for the machine type's PrepareWaveMetrics, either in
+// full or by sampling windows (--quickanalyze)
+void CCommandStd::AnalyseInputWave(CTapeReader* wf, WAVE_INFO& info)
+{
+	fprintf(stderr, "\n\nAnalysing wave data...");
+
+	if (analyzeWindows > 0)
+	{
+		WAVE_ESTIMATE est;
+		if (EstimateWave(wf->GetWaveReader(), _cycleDetector.GetMode(), analyzeWindows, info, est))
+		{
+			fprintf(stderr, "\n    sampled %i windows, %i cycles", est.windows, est.sampledCycles);
+			fprintf(stderr, "\n    short cycle length: %i (95%% interval %i-%i)", info.medianShortCycleLength, est.shortCycleLow, est.shortCycleHigh);
+			fprintf(stderr, "\n    long cycle length:  %i (95%% interval %i-%i)", info.medianLongCycleLength, est.longCycleLow, est.longCycleHigh);
+			if (est.stable)
+			{
+				fprintf(stderr, "\n\n");
+				return;
+			}
+
+			fprintf(stderr, "\n    estimate unstable, analysing entire file...");
+		}
+	}
+
+	AnalyseWave(wf->GetWaveReader(), _cycleDetector.GetMode(), 0, 0, info);
+	fprintf(stderr, "\n\n");
+}
+
 int CCommandStd::PreProcess()
 {
 	if (machine==NULL)
@@ -429,8 +566,17 @@ int CCommandStd::PreProcess()
 
 int CCommandStd::PostProcess()
 {
+	// Running out of stream window isn't the end of the input, so don't let
+	// the output look like it finished normally
+	int err = 0;
+	if (file!=NULL && file->IsWaveFile() && ((CTapeReader*)file)->GetWaveReader()->StreamWindowExceeded())
+	{
+		printf("\n[error: decoding stopped early, a re-sync needed more of the input stream than --streamwindow keeps]\n");
+		err = 7;
+	}
+
 	CloseFiles();
-	return 0;
+	return err;
 }
 
 
@@ -439,6 +585,7 @@ void CCommandStd::ShowCommonUsage()
 	printf("\nThe input file can be either:\n");
 	printf("  - an 8 or 16 bit PCM mono .wav file, or \n");
 	printf("  - a .txt file containing the (possibly edited) previously output of this program\n");
+	printf("  - a %s file previously written with --binary-out\n", DUMP_FILE_EXTENSION);
 	printf("  - a binary file containing data to be processed\n");
 
 	printf("\nThe type of output is determined by the outputFile extension:\n");
@@ -448,6 +595,7 @@ void CCommandStd::ShowCommonUsage()
 	printf("  - .bee - a Microbee BEE file\n");
 	printf("  - .cas - generates a TRS-80 cassette file\n");
 	printf("  - anything else - generates a raw binary containing the transformed input data\n");
+	printf("  - '-' on its own - streams a .wav to stdout (text output goes to stderr)\n");
 
 	printf("\nMachine Type:\n");
 	printf("  --trs80               TRS-80 mode\n");
@@ -457,8 +605,13 @@ void CCommandStd::ShowCommonUsage()
 	printf("\nWave Input Options:\n");
 	CCommandWithInputWaveFile::ShowHelp();
 	printf("  --noanalyze           determine cycle length by analysis (don't trust sample rate)\n");
+	printf("  --quickanalyze[:N]    estimate wave metrics from N one second windows (N=32 if not specified)\n");
+	printf("  --workingrate[:N]     decimate high sample rate input to about N Hz before decoding (N=44100 if not specified)\n");
 	printf("  --allowbadcycles      don't limit check cycle lengths (within reason)\n");
 	printf("  --strict              strictly convert cycle patterns to bits\n");
+	printf("  --viterbi             convert cycle patterns to bits by best fit rather than by rules (Microbee)\n");
+	printf("  --demod               find cycle kinds by the energy in each tone rather than by cycle timing (Microbee)\n");
+	printf("  --nocycleindex        don't use (or create) the .cycleindex file of cycle boundaries\n");
 	printf("  --cyclefreq:N         explicitly set the short cycle frequency\n");
 	printf("  --speedchangepos:N    specify an explicit speed change at N\n");
 	printf("  --speedchangespeed:N  specify the new speed (in baud) at the speed change point\n");
@@ -469,6 +622,8 @@ void CCommandStd::ShowCommonUsage()
 	printf("  --syncinfo            show details of bit and byte sync operations\n");
 	printf("  --perline:N           display N piece of data per line (default depends on data kind)\n");
 	printf("  --noposinfo           don't dump position info\n");
+	printf("  --live                show output as soon as it's decoded (eg: when streaming a capture to stdin)\n");
+	printf("  --binary-out:file     also write the dumped data and positions to a binary %s file\n", DUMP_FILE_EXTENSION);
 	printf("  --showcycles          show cycle boundaries with --samples\n");
 	printf("  --samplecount         number of samples to dump with --samples\n");
 
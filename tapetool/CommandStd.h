@@ -6,9 +6,15 @@
 
 #include "CommandWithInputWaveFile.h"
 
+// Value of speedChangePos when no speed change position has been set
+#define SPEED_CHANGE_NONE	0x7FFFFFFFFFFFFFFFLL
+
 class CMachineType;
 class CFileReader;
+class CTapeReader;
+struct WAVE_INFO;
 class CWaveWriter;
+class CDumpWriter;
 enum CycleMode;
 enum Resolution;
 
@@ -33,6 +39,7 @@ public:
 	double leadingSilence;
 	int leadingZeros;
 	bool autoAnalyze;
+	int analyzeWindows;
 	int renderSampleRate;
 	int renderSampleSize;
 	int renderVolume;
@@ -45,12 +52,18 @@ public:
 	const char* inputFormat;
 	Resolution instrumentRes;
 	const char* profileFileName;
-	int speedChangePos;
+	int64 speedChangePos;
 	int speedChangeSpeed;
 	bool _includeProfiledLeadIn;
 	bool _includeProfiledLeadOut;
 	bool _strict;
+	bool _viterbi;
+	bool _demod;
+	int _workingRate;
 	bool _fixTiming;
+	bool _useCycleIndex;
+	bool _live;
+	const char* _binaryOutFileName;
 	CContext* _ctx;
 
 
@@ -58,6 +71,7 @@ public:
 	CFileReader* file;
 	CWaveWriter* renderFile;
 	FILE* binaryFile;
+	CDumpWriter* dumpFile;
 
 
 // Operations
@@ -67,10 +81,12 @@ public:
 	bool IsOutputKind(const char* ext);
 	void ResetByteDump();
 	void DumpByte(int byte);
+	void AnalyseInputWave(CTapeReader* wf, WAVE_INFO& info);
 
 	virtual bool DoesTranslateFromWaveData() { return true; }
 	virtual bool DoesTranslateToWaveData() { return true; }
 	virtual bool UsesAutoOutputFile() { return true; }
+	virtual bool DoesWriteBinaryDump() { return false; }
 
 	virtual int PreProcess();
 	virtual int PostProcess();
@@ -82,6 +98,7 @@ protected:
 	bool OpenOutputFile(Resolution res);
 	bool OpenRenderFile(const char* filename);
 	bool OpenBinaryFile(const char* filename);
+	bool OpenDumpFile(Resolution res);
 };
 
 
@@ -9,6 +9,20 @@
 
 CCommandWaveStats::CCommandWaveStats()
 {
+	_threads = 0;
+}
+
+int CCommandWaveStats::AddSwitch(const char* arg, const char* val)
+{
+	if (_strcmpi(arg, "threads")==0)
+	{
+		_threads = val==NULL ? 0 : atoi(val);
+	}
+	else
+	{
+		return CCommandWithRangedInputWaveFile::AddSwitch(arg, val);
+	}
+	return 0;
 }
 
 // Command handler for dumping samples
@@ -24,14 +38,14 @@ int CCommandWaveStats::Process()
 
 	// Analyse the wave
 	WAVE_INFO info;
-	AnalyseWave(&wave, _cycleDetector.GetMode(), GetStartSample(), GetEndSample(), info);
+	AnalyseWave(&wave, _cycleDetector.GetMode(), GetStartSample(), GetEndSample(), _threads, info);
 
 	fprintf(stderr, "\n\n");
 
 	printf("[\n");
 	printf("    Sample Rate:               %iHz\n", wave.GetSampleRate());
 	printf("    Bits Per Sample:           %i\n", wave.GetBytesPerSample() * 8);
-	printf("    Length:                    %i samples\n", info.totalSamples);
+	printf("    Length:                    %lli samples\n", info.totalSamples);
 	printf("    Duration:                  %.2f seconds\n", ((double)info.totalSamples)/wave.GetSampleRate() );
 	printf("    Total Cycles:              %i\n", info.totalCycles);
 	printf("    Average Samples/Cycle:     %i (%.1fHz)\n", info.avgSamplesPerCycle, info.avgCycleFrequency);
@@ -59,5 +73,6 @@ void CCommandWaveStats::ShowUsage()
 	printf("\nOptions:\n");
 	printf("  --help                Show these usage instructions\n");
 	CCommandWithRangedInputWaveFile::ShowHelp();
+	printf("  --threads:N           analyse using N threads (default = one per processor)\n");
 	printf("\n\n");
 }
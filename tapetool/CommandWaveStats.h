@@ -11,10 +11,13 @@ class CCommandWaveStats : public CCommandWithRangedInputWaveFile
 public:
 	CCommandWaveStats();
 
+	virtual int AddSwitch(const char* arg, const char* val);
 	virtual int Process();
 	virtual bool DoesTranslateFromWaveData() { return false; }
 	virtual const char* GetCommandName() { return "analyse"; }
 	virtual void ShowUsage();
+
+	int _threads;
 };
 
 #endif	// __COMMANDWAVESTATS_H
@@ -5,6 +5,7 @@
 
 #include "CommandWithInputWaveFile.h"
 #include "WaveReader.h"
+#include "FilterChain.h"
 
 CCommandWithInputWaveFile::CCommandWithInputWaveFile() : _cycleDetector(cmZeroCrossingUp)
 {
@@ -13,6 +14,8 @@ CCommandWithInputWaveFile::CCommandWithInputWaveFile() : _cycleDetector(cmZeroCr
 	_amplify = 1;
 	_smoothing = 0;
 	_makeSquareWave = false;
+	_streamWindow = DEFAULT_STREAM_WINDOW;
+	_dsp = NULL;
 }
 
 bool CCommandWithInputWaveFile::OpenWaveReader(CWaveReader& wave, const char* filename)
@@ -31,6 +34,7 @@ bool CCommandWithInputWaveFile::OpenWaveReader(CWaveReader& wave)
 	}
 
 	// Open the input file
+	wave.SetStreamWindow(_streamWindow);
 	if (!wave.OpenFile(_filename))
 	{
 		fprintf(stderr, "Failed to open '%s'", _filename);
@@ -42,6 +46,12 @@ bool CCommandWithInputWaveFile::OpenWaveReader(CWaveReader& wave)
 	wave.SetSmoothingPeriod(_smoothing);
 	wave.SetMakeSquareWave(_makeSquareWave);
 
+	if (_dsp!=NULL && !wave.SetFilterChain(_dsp))
+	{
+		fprintf(stderr, "Failed to setup --dsp:%s for '%s'", _dsp, _filename);
+		return false;
+	}
+
 	return true;
 }
 
@@ -76,6 +86,21 @@ int CCommandWithInputWaveFile::AddSwitch(const char* arg, const char* val)
 	{
 		_makeSquareWave = true;
 	}
+	else if (_strcmpi(arg, "streamwindow")==0)
+	{
+		_streamWindow = val==NULL ? DEFAULT_STREAM_WINDOW : atof(val);
+	}
+	else if (_strcmpi(arg, "dsp")==0)
+	{
+		// Check it now so errors show before any processing starts
+		CFilterChain chain;
+		if (val==NULL || !chain.Parse(val))
+		{
+			fprintf(stderr, "Invalid --dsp filter chain: `%s`\n", val==NULL ? "" : val);
+			return 7;
+		}
+		_dsp = val;
+	}
 	else
 	{
 		return CCommand::AddSwitch(arg, val);
@@ -100,6 +125,8 @@ void CCommandWithInputWaveFile::ShowHelp()
 	printf("  --dcoffset:N          offset sample values by this amount (DC Offset)\n");
 	printf("  --amplify:N           amplify input signal by N%% (eg: 50 halves the signal amplitude)\n");
 	printf("  --tosquarewave        convert the input signal to a square wave\n");
+	printf("  --streamwindow:N      seconds of input kept for seeking back when reading stdin or a pipe (default 30)\n");
+	CFilterChain::ShowHelp();
 	if (DoesUseCycleMode())
 	{
 	printf("  --cyclemode:mode      cycle detection mode\n");                 
@@ -27,6 +27,8 @@ public:
 	double _amplify;
 	int _smoothing;
 	bool _makeSquareWave;
+	double _streamWindow;
+	const char* _dsp;
 	CCycleDetector _cycleDetector;
 };
 
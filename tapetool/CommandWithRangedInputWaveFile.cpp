@@ -17,15 +17,15 @@ int CCommandWithRangedInputWaveFile::AddSwitch(const char* arg, const char* val)
 {
 	if (_strcmpi(arg, "startsample")==0)
 	{
-		_start = val==NULL ? 0 : atoi(val);
+		_start = val==NULL ? 0 : atoi64(val);
 	}
 	else if (_strcmpi(arg, "samplecount")==0)
 	{
-		_count = val==NULL ? 0 : atoi(val);
+		_count = val==NULL ? 0 : atoi64(val);
 	}
 	else if (_strcmpi(arg, "endsample")==0)
 	{
-		_end = val==NULL ? 0 : atoi(val);
+		_end = val==NULL ? 0 : atoi64(val);
 	}
 	else
 	{
@@ -69,12 +69,12 @@ bool CCommandWithRangedInputWaveFile::OpenWaveReader(CWaveReader& wave)
 
 
 
-int CCommandWithRangedInputWaveFile::GetStartSample()
+int64 CCommandWithRangedInputWaveFile::GetStartSample()
 {
 	return _startCalculated;
 }
 
-int CCommandWithRangedInputWaveFile::GetEndSample()
+int64 CCommandWithRangedInputWaveFile::GetEndSample()
 {
 	return _endCalculated;
 }
@@ -13,19 +13,19 @@ public:
 
 	virtual int AddSwitch(const char* arg, const char* val);
 
-	int GetStartSample();
-	int GetEndSample();
+	int64 GetStartSample();
+	int64 GetEndSample();
 
 	bool OpenWaveReader(CWaveReader& wave);
 	void ShowHelp();
 
 private:
-	int _start;
-	int _end;
-	int _count;
+	int64 _start;
+	int64 _end;
+	int64 _count;
 
-	int _startCalculated;
-	int _endCalculated;
+	int64 _startCalculated;
+	int64 _endCalculated;
 };
 
 #endif	// __COMMANDWITHRANGEDINPUTWAVEFILE_H
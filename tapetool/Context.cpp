@@ -39,7 +39,8 @@ int CContext::ProcessCommandLineArg(const char* arg)
 	if (arg[0]=='-' && arg[1]=='-')
 		arg++;
 
-	if (arg[0]=='-')
+	// A lone "-" is a file name (stdout/stdin)
+	if (arg[0]=='-' && arg[1]!='\0')
 	{
 		arg++;
 
@@ -167,8 +168,8 @@ int CContext::Run(int argc,char **argv)
 
 		err = _cmd->Process();
 
-		_cmd->PostProcess();
-		return err;
+		int postErr = _cmd->PostProcess();
+		return err!=0 ? err : postErr;
 	}
 
 	// Nothing specified!
@@ -5,6 +5,19 @@
 
 #include "CycleDetector.h"
 
+// Pick the widest vector unit available at compile time
+#if defined(__AVX2__)
+#define SCAN_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 CCycleDetector::CCycleDetector(CycleMode mode)
 {
 	Reset(mode);
@@ -16,6 +29,16 @@ void CCycleDetector::Reset(CycleMode mode)
 	_prevDirection = 0;
 	_prev = 0;
 	_first = true;
+
+	switch (mode)
+	{
+		case cmZeroCrossingUp: _scan = &CCycleDetector::ScanZeroCrossings<cmZeroCrossingUp>; break;
+		case cmZeroCrossingDown: _scan = &CCycleDetector::ScanZeroCrossings<cmZeroCrossingDown>; break;
+		case cmMaxima: _scan = &CCycleDetector::ScanTurningPoints<cmMaxima>; break;
+		case cmMinima: _scan = &CCycleDetector::ScanTurningPoints<cmMinima>; break;
+		case cmPositiveMaxima: _scan = &CCycleDetector::ScanTurningPoints<cmPositiveMaxima>; break;
+		case cmNegativeMinima: _scan = &CCycleDetector::ScanTurningPoints<cmNegativeMinima>; break;
+	}
 }
 
 
@@ -87,6 +110,198 @@ bool CCycleDetector::IsNewCycle(int sample)
 	return retv;
 }
 
+// Put the detector into the state it would be in immediately after
+// reporting a new cycle at the specified sample
+void CCycleDetector::SetCycleState(int sample)
+{
+	switch (_mode)
+	{
+		case cmMaxima:
+		case cmPositiveMaxima:
+			_prevDirection = -1;
+			break;
+
+		case cmMinima:
+		case cmNegativeMinima:
+			_prevDirection = 1;
+			break;
+
+		default:
+			_prevDirection = 0;
+			break;
+	}
+
+	_prev = sample;
+	_first = false;
+}
+
+// Does this mode track the direction of the waveform (ie: maxima/minima
+// modes), as opposed to just the previous sample?
+bool CCycleDetector::UsesDirection()
+{
+	return _mode!=cmZeroCrossingUp && _mode!=cmZeroCrossingDown;
+}
+
+// Index of the lowest set bit in a non-zero mask
+static inline int LowestBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// Is the step from prev to sample a zero crossing in the required direction?
+template<CycleMode mode>
+static inline bool IsCrossing(int prev, int sample)
+{
+	if (mode==cmZeroCrossingUp)
+		return prev<=0 && sample>0;
+	else
+		return prev>=0 && sample<0;
+}
+
+// Zero crossing kernel.  Compares each sample with its predecessor a vector at
+// a time and only drops to scalar code for the (relatively rare) crossings
+template<CycleMode mode>
+int CCycleDetector::ScanZeroCrossings(const int* samples, int count, int* offsets, int maxOffsets)
+{
+	if (count==0 || maxOffsets==0)
+		return 0;
+
+	// The first sample is compared against the previous buffer's last sample
+	int found = 0;
+	if (_first || IsCrossing<mode>(_prev, samples[0]))
+	{
+		offsets[found++] = 0;
+		if (found==maxOffsets)
+		{
+			_prev = samples[0];
+			_first = false;
+			return found;
+		}
+	}
+	_first = false;
+
+	int i = 1;
+
+#if defined(SCAN_AVX2)
+	__m256i zero = _mm256_setzero_si256();
+	for (; i+8<=count; i+=8)
+	{
+		__m256i prev = _mm256_loadu_si256((const __m256i*)(samples+i-1));
+		__m256i curr = _mm256_loadu_si256((const __m256i*)(samples+i));
+		__m256i hit;
+		if (mode==cmZeroCrossingUp)
+			hit = _mm256_andnot_si256(_mm256_cmpgt_epi32(prev, zero), _mm256_cmpgt_epi32(curr, zero));
+		else
+			hit = _mm256_andnot_si256(_mm256_cmpgt_epi32(zero, prev), _mm256_cmpgt_epi32(zero, curr));
+
+		unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(hit));
+		while (mask)
+		{
+			int offset = i + LowestBit(mask);
+			offsets[found++] = offset;
+			if (found==maxOffsets)
+			{
+				_prev = samples[offset];
+				return found;
+			}
+			mask &= mask - 1;
+		}
+	}
+#elif defined(SCAN_SSE2)
+	__m128i zero = _mm_setzero_si128();
+	for (; i+4<=count; i+=4)
+	{
+		__m128i prev = _mm_loadu_si128((const __m128i*)(samples+i-1));
+		__m128i curr = _mm_loadu_si128((const __m128i*)(samples+i));
+		__m128i hit;
+		if (mode==cmZeroCrossingUp)
+			hit = _mm_andnot_si128(_mm_cmpgt_epi32(prev, zero), _mm_cmpgt_epi32(curr, zero));
+		else
+			hit = _mm_andnot_si128(_mm_cmpgt_epi32(zero, prev), _mm_cmpgt_epi32(zero, curr));
+
+		unsigned int mask = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(hit));
+		while (mask)
+		{
+			int offset = i + LowestBit(mask);
+			offsets[found++] = offset;
+			if (found==maxOffsets)
+			{
+				_prev = samples[offset];
+				return found;
+			}
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	for (; i<count; i++)
+	{
+		if (IsCrossing<mode>(samples[i-1], samples[i]))
+		{
+			offsets[found++] = i;
+			if (found==maxOffsets)
+			{
+				_prev = samples[i];
+				return found;
+			}
+		}
+	}
+
+	_prev = samples[count-1];
+	return found;
+}
+
+// Maxima/minima kernel.  The direction carries across flat runs so this is
+// inherently serial, but the per sample work is branch free
+template<CycleMode mode>
+int CCycleDetector::ScanTurningPoints(const int* samples, int count, int* offsets, int maxOffsets)
+{
+	if (count==0 || maxOffsets==0)
+		return 0;
+
+	int found = 0;
+	int prev = _prev;
+	int prevDirection = _prevDirection;
+	for (int i=0; i<count; i++)
+	{
+		int sample = samples[i];
+
+		// -1, 0 or 1, keeping the previous direction if unchanged
+		int step = (sample > prev) - (sample < prev);
+		int direction = step | (prevDirection & -(step==0));
+
+		int turn;
+		switch (mode)
+		{
+			case cmMaxima: turn = (direction<0) & (prevDirection>=0); break;
+			case cmMinima: turn = (direction>0) & (prevDirection<=0); break;
+			case cmPositiveMaxima: turn = (direction<0) & (prevDirection>=0) & (sample>0); break;
+			default: turn = (direction>0) & (prevDirection<=0) & (sample<0); break;
+		}
+
+		prevDirection = direction;
+		prev = sample;
+
+		if (turn)
+		{
+			offsets[found++] = i;
+			if (found==maxOffsets)
+				break;
+		}
+	}
+
+	_prev = prev;
+	_prevDirection = prevDirection;
+	_first = false;
+	return found;
+}
+
 int CCycleDetector::CalculateDirection(int sample)
 {
 	if (sample > _prev)
@@ -22,7 +22,20 @@ public:
 	void Reset();
 	void Reset(CycleMode mode);
 	CycleMode GetMode();
+	int GetDirection() { return _prevDirection; }
 	bool IsNewCycle(int sample);
+	void SetCycleState(int sample);
+
+	// Scan a buffer of samples storing the offsets of up to maxOffsets new
+	// cycles.  Returns the number found.  Samples are consumed up to and
+	// including the last cycle found if maxOffsets is reached, otherwise the
+	// entire buffer is consumed.
+	int FindCycles(const int* samples, int count, int* offsets, int maxOffsets)
+	{
+		return (this->*_scan)(samples, count, offsets, maxOffsets);
+	}
+
+	bool UsesDirection();
 
 	static const char* ToString(CycleMode mode);
 	static bool FromString(const char* pszm, CycleMode& mode);
@@ -30,6 +43,14 @@ public:
 protected:
 	int CalculateDirection(int sample);
 
+	template<CycleMode mode>
+	int ScanZeroCrossings(const int* samples, int count, int* offsets, int maxOffsets);
+	template<CycleMode mode>
+	int ScanTurningPoints(const int* samples, int count, int* offsets, int maxOffsets);
+
+	// Scan kernel for the current mode, chosen by Reset
+	int (CCycleDetector::*_scan)(const int* samples, int count, int* offsets, int maxOffsets);
+
 	CycleMode _mode;
 	int _prev;
 	int _prevDirection;
@@ -0,0 +1,307 @@
+//////////////////////////////////////////////////////////////////////////
+// CycleIndex.cpp - implementation of CCycleIndex class
+
+#include "precomp.h"
+
+#include "CycleIndex.h"
+#include "WaveReader.h"
+
+#include <sys/stat.h>
+
+//////////////////////////////////////////////////////////////////////////
+// CCycleIndex
+
+// Constructor
+CCycleIndex::CCycleIndex()
+{
+	_checkpoints = NULL;
+	_lengths = NULL;
+	_buffer = NULL;
+	Close();
+}
+
+// Destructor
+CCycleIndex::~CCycleIndex()
+{
+	Close();
+}
+
+// Load the index for the wave file's current settings from its sidecar file,
+// or build it (and try to save it for next time) if the sidecar is missing
+// or stale.  The wave reader is left positioned where it was.
+bool CCycleIndex::Open(CWaveReader& wave, CycleMode mode)
+{
+	Close();
+
+	CYCLE_INDEX_HEADER header;
+	if (!InitHeader(wave, mode, header))
+		return false;
+
+	char temp[1024];
+	if (strlen(wave.GetFileName()) + 13 > sizeof(temp))
+		return false;
+	strcpy(temp, wave.GetFileName());
+	strcat(temp, ".cycleindex");
+
+	if (Load(temp, header))
+		return true;
+
+	int64 savePos = wave.CurrentPosition();
+	bool ok = Build(wave, mode, header);
+	wave.Seek(savePos);
+
+	if (ok)
+		Save(temp);
+
+	return ok;
+}
+
+void CCycleIndex::Close()
+{
+	_map.Close();
+	if (_buffer!=NULL)
+		free(_buffer);
+
+	memset(&_header, 0, sizeof(_header));
+	_checkpoints = NULL;
+	_lengths = NULL;
+	_buffer = NULL;
+	_cursor = -1;
+	_cursorPosition = 0;
+}
+
+bool CCycleIndex::IsOpen()
+{
+	return _lengths!=NULL;
+}
+
+int64 CCycleIndex::GetCycleCount()
+{
+	return _header._cycleCount;
+}
+
+// Find the first cycle boundary after the specified position
+bool CCycleIndex::FindNext(int64 position, int64& boundary)
+{
+	int64 count = _header._cycleCount;
+	if (count==0)
+		return false;
+
+	// Unless we're continuing on from the cursor (the usual case), binary search
+	// the checkpoints for where to start
+	int64 checkpointCount = (count + CYCLE_INDEX_CHECKPOINT - 1) / CYCLE_INDEX_CHECKPOINT;
+	int64 nextCheckpoint = _cursor / CYCLE_INDEX_CHECKPOINT + 1;
+	if (_cursor<0 || _cursorPosition > position ||
+		(nextCheckpoint < checkpointCount && _checkpoints[nextCheckpoint] <= position))
+	{
+		if (_checkpoints[0] > position)
+		{
+			_cursor = 0;
+			_cursorPosition = _checkpoints[0];
+			boundary = _cursorPosition;
+			return true;
+		}
+
+		int64 lo = 0;
+		int64 hi = checkpointCount - 1;
+		while (lo < hi)
+		{
+			int64 mid = (lo + hi + 1) / 2;
+			if (_checkpoints[mid] <= position)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+
+		_cursor = lo * CYCLE_INDEX_CHECKPOINT;
+		_cursorPosition = _checkpoints[lo];
+	}
+
+	// Walk forward
+	while (_cursorPosition <= position)
+	{
+		if (_cursor + 1 >= count)
+			return false;
+
+		_cursor++;
+		_cursorPosition += _lengths[_cursor];
+	}
+
+	boundary = _cursorPosition;
+	return true;
+}
+
+// Work out what the header for the wave file's current settings should be
+bool CCycleIndex::InitHeader(CWaveReader& wave, CycleMode mode, CYCLE_INDEX_HEADER& header)
+{
+	memset(&header, 0, sizeof(header));
+
+#ifdef _MSC_VER
+	struct _stat64 st;
+	if (_stat64(wave.GetFileName(), &st)!=0)
+		return false;
+#else
+	struct stat st;
+	if (stat(wave.GetFileName(), &st)!=0)
+		return false;
+#endif
+
+	header._sig = CYCLE_INDEX_SIG;
+	header._headerSize = sizeof(header);
+	header._fileLength = st.st_size;
+	header._fileTime = st.st_mtime;
+	header._totalSamples = wave.GetTotalSamples();
+	header._sampleRate = wave.GetSampleRate();
+	header._bytesPerSample = wave.GetBytesPerSample();
+	header._smoothing = wave.GetSmoothingPeriod();
+	header._dcOffset = wave.GetDCOffset();
+	header._amplify = wave.GetAmplify();
+	header._square = wave.GetMakeSquareWave() ? 1 : 0;
+	header._cycleMode = mode;
+	header._filterChain = wave.GetFilterChainHash();
+	return true;
+}
+
+// Map a previously saved index, checking it matches the expected header
+bool CCycleIndex::Load(const char* filename, const CYCLE_INDEX_HEADER& header)
+{
+	if (!_map.Open(filename))
+		return false;
+
+	if (_map.GetLength() < (int64)sizeof(CYCLE_INDEX_HEADER))
+	{
+		_map.Close();
+		return false;
+	}
+
+	// Everything except the cycle count must match
+	const CYCLE_INDEX_HEADER* saved = (const CYCLE_INDEX_HEADER*)_map.GetData();
+	CYCLE_INDEX_HEADER check = *saved;
+	check._cycleCount = 0;
+	if (memcmp(&check, &header, sizeof(header))!=0)
+	{
+		_map.Close();
+		return false;
+	}
+
+	// Check the length is right for the number of cycles
+	int64 count = saved->_cycleCount;
+	int64 checkpointCount = (count + CYCLE_INDEX_CHECKPOINT - 1) / CYCLE_INDEX_CHECKPOINT;
+	if (count<0 || _map.GetLength() != (int64)sizeof(CYCLE_INDEX_HEADER) + checkpointCount * 8 + count * 4)
+	{
+		_map.Close();
+		return false;
+	}
+
+	_header = *saved;
+	_checkpoints = (const int64*)(saved + 1);
+	_lengths = (const unsigned int*)(_checkpoints + checkpointCount);
+	return true;
+}
+
+// Run the cycle detector over the entire file
+bool CCycleIndex::Build(CWaveReader& wave, CycleMode mode, const CYCLE_INDEX_HEADER& header)
+{
+	CCycleDetector cd(mode);
+
+	unsigned int* lengths = NULL;
+	int64 count = 0;
+	int64 allocated = 0;
+	int64 position = 0;
+	int64 prevBoundary = 0;
+
+	int samples[SAMPLE_BLOCK_SIZE];
+	int offsets[SAMPLE_BLOCK_SIZE];
+	wave.Seek(0);
+	while (true)
+	{
+		int n = wave.ReadSamples(samples, SAMPLE_BLOCK_SIZE);
+		if (n==0)
+			break;
+
+		int found = cd.FindCycles(samples, n, offsets, n);
+		for (int i=0; i<found; i++)
+		{
+			int64 boundary = position + offsets[i] + 1;
+
+			// Cycles too long for 32-bits can't be indexed
+			if (boundary - prevBoundary > 0xFFFFFFFFLL)
+			{
+				free(lengths);
+				return false;
+			}
+
+			if (count==allocated)
+			{
+				allocated = allocated==0 ? 65536 : allocated * 2;
+				unsigned int* p = (unsigned int*)realloc(lengths, (size_t)allocated * sizeof(unsigned int));
+				if (p==NULL)
+				{
+					free(lengths);
+					return false;
+				}
+				lengths = p;
+			}
+
+			lengths[count++] = (unsigned int)(boundary - prevBoundary);
+			prevBoundary = boundary;
+		}
+
+		position += n;
+	}
+
+	// Lay it out the same as the saved file (less the header)
+	int64 checkpointCount = (count + CYCLE_INDEX_CHECKPOINT - 1) / CYCLE_INDEX_CHECKPOINT;
+	_buffer = malloc((size_t)(checkpointCount * 8 + count * 4) + 1);
+	if (_buffer==NULL)
+	{
+		free(lengths);
+		return false;
+	}
+
+	int64* checkpoints = (int64*)_buffer;
+	unsigned int* storedLengths = (unsigned int*)(checkpoints + checkpointCount);
+	if (count)
+		memcpy(storedLengths, lengths, (size_t)count * sizeof(unsigned int));
+	free(lengths);
+
+	int64 pos = 0;
+	for (int64 i=0; i<count; i++)
+	{
+		pos += storedLengths[i];
+		if ((i % CYCLE_INDEX_CHECKPOINT)==0)
+			checkpoints[i / CYCLE_INDEX_CHECKPOINT] = pos;
+	}
+
+	_header = header;
+	_header._cycleCount = count;
+	_checkpoints = checkpoints;
+	_lengths = storedLengths;
+	return true;
+}
+
+// Write the index to disk.  Failure isn't an error, the index just gets
+// rebuilt next time.
+bool CCycleIndex::Save(const char* filename)
+{
+	FILE* file = fopen(filename, "wb");
+	if (file==NULL)
+		return false;
+
+	int64 count = _header._cycleCount;
+	int64 checkpointCount = (count + CYCLE_INDEX_CHECKPOINT - 1) / CYCLE_INDEX_CHECKPOINT;
+
+	bool ok = fwrite(&_header, sizeof(_header), 1, file)==1;
+	if (ok && checkpointCount)
+		ok = fwrite(_checkpoints, 8, (size_t)checkpointCount, file)==(size_t)checkpointCount;
+	if (ok && count)
+		ok = fwrite(_lengths, 4, (size_t)count, file)==(size_t)count;
+
+	fclose(file);
+
+	if (!ok)
+		remove(filename);
+
+	return ok;
+}
+
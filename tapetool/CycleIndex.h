@@ -0,0 +1,72 @@
+//////////////////////////////////////////////////////////////////////////
+// CycleIndex.h - declaration of CCycleIndex class
+
+#ifndef __CYCLEINDEX_H
+#define __CYCLEINDEX_H
+
+#include "MappedFile.h"
+#include "CycleDetector.h"
+
+class CWaveReader;
+
+// Signature of binary cycle index files
+#define CYCLE_INDEX_SIG			0x58444943
+
+// Number of cycles between absolute position checkpoints
+#define CYCLE_INDEX_CHECKPOINT	256
+
+// Everything that affects where cycle boundaries fall.  If any of this
+// differs from the current run the index is rebuilt
+struct CYCLE_INDEX_HEADER
+{
+	int				_sig;
+	int				_headerSize;
+	int64			_fileLength;
+	int64			_fileTime;
+	int64			_totalSamples;
+	int				_sampleRate;
+	int				_bytesPerSample;
+	int				_smoothing;
+	int				_dcOffset;
+	double			_amplify;
+	int				_square;
+	int				_cycleMode;
+	unsigned int	_filterChain;
+	int64			_cycleCount;
+};
+
+// CCycleIndex - positions of every cycle boundary in a wave file, as found
+// by a single forward pass of the cycle detector from the start of the file.
+// Stored as 32-bit cycle lengths with a 64-bit absolute position every
+// CYCLE_INDEX_CHECKPOINT cycles.
+class CCycleIndex
+{
+public:
+			CCycleIndex();
+	virtual ~CCycleIndex();
+
+	bool Open(CWaveReader& wave, CycleMode mode);
+	void Close();
+	bool IsOpen();
+	int64 GetCycleCount();
+	bool FindNext(int64 position, int64& boundary);
+
+protected:
+	bool InitHeader(CWaveReader& wave, CycleMode mode, CYCLE_INDEX_HEADER& header);
+	bool Load(const char* filename, const CYCLE_INDEX_HEADER& header);
+	bool Build(CWaveReader& wave, CycleMode mode, const CYCLE_INDEX_HEADER& header);
+	bool Save(const char* filename);
+
+	CYCLE_INDEX_HEADER	_header;
+	CMappedFile			_map;
+	const int64*		_checkpoints;
+	const unsigned int*	_lengths;
+	void*				_buffer;		// when built rather than mapped
+
+	// Sequential access cursor
+	int64				_cursor;
+	int64				_cursorPosition;
+};
+
+#endif	// __CYCLEINDEX_H
+
@@ -0,0 +1,152 @@
+//////////////////////////////////////////////////////////////////////////
+// DumpFile.cpp - implementation of CDumpWriter class
+
+#include "precomp.h"
+
+#include "DumpFile.h"
+#include "TapeReader.h"
+
+//////////////////////////////////////////////////////////////////////////
+// CDumpWriter
+
+// Constructor
+CDumpWriter::CDumpWriter()
+{
+	_file = NULL;
+	_res = resNA;
+	_ok = true;
+	_count = 0;
+	_lastPosition = 0;
+	_endPosition = 0;
+	_chunkPosition = 0;
+	_chunkCount = 0;
+}
+
+// Destructor
+CDumpWriter::~CDumpWriter()
+{
+	if (_file!=NULL)
+		fclose(_file);
+}
+
+// Create the file now so any error is reported before processing starts.  The
+// header is left blank until Close.
+bool CDumpWriter::Create(const char* filename, Resolution res)
+{
+	_file = fopen(filename, "wb");
+	if (_file==NULL)
+	{
+	    fprintf(stderr, "Could not create '%s' - %s (%i)\n", filename, strerror(errno), errno);
+		return false;
+	}
+
+	DUMP_FILE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	_ok = fwrite(&header, sizeof(header), 1, _file)==1;
+
+	_res = res;
+	return true;
+}
+
+void CDumpWriter::Add(int64 position, int64 endPosition, int value)
+{
+	AddEntry(position, 0, value);
+	_endPosition = endPosition;
+}
+
+// Record that decoding failed at a position (and was re-synced after it)
+void CDumpWriter::AddError(int64 position)
+{
+	AddEntry(position, DUMP_ENTRY_ERROR, 0);
+	_endPosition = position;
+}
+
+void CDumpWriter::AddEntry(int64 position, unsigned int flags, int value)
+{
+	if (!_ok)
+		return;
+
+	int64 delta = _count==0 ? 0 : position - _lastPosition;
+	if (delta < 0 || delta >= DUMP_ENTRY_ERROR)
+	{
+		fprintf(stderr, "Can't write binary dump, positions out of order or too far apart at %lli\n", position);
+		_ok = false;
+		return;
+	}
+
+	if (_chunkCount==0)
+		_chunkPosition = position;
+	_chunkDeltas[_chunkCount] = (unsigned int)delta | flags;
+	_chunkValues[_chunkCount] = value;
+	_chunkCount++;
+	_count++;
+	_lastPosition = position;
+
+	if (_chunkCount==DUMP_FILE_CHECKPOINT)
+		_ok = FlushChunk();
+}
+
+// Write out the entries collected so far as a chunk
+bool CDumpWriter::FlushChunk()
+{
+	if (_chunkCount==0)
+		return true;
+
+	size_t n = _chunkCount;
+	_chunkCount = 0;
+
+	if (fwrite(&_chunkPosition, sizeof(int64), 1, _file)!=1 || fwrite(_chunkDeltas, sizeof(unsigned int), n, _file)!=n)
+		return false;
+
+	if (_res==resCycles)
+		return fwrite(_chunkValues, sizeof(int), n, _file)==n;
+
+	unsigned char bytes[DUMP_FILE_CHECKPOINT];
+	for (size_t i=0; i<n; i++)
+		bytes[i] = (unsigned char)_chunkValues[i];
+	return fwrite(bytes, 1, n, _file)==n;
+}
+
+// Write the last chunk and the header.  The source file supplies the position
+// it ended up at and, for wave files, the cycle lengths used to classify cycles.
+bool CDumpWriter::Close(CFileReader* source, const char* dataFormat)
+{
+	if (_file==NULL)
+		return false;
+
+	DUMP_FILE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header._sig = DUMP_FILE_SIG;
+	header._version = DUMP_FILE_VERSION;
+	header._headerSize = sizeof(header);
+	header._res = _res;
+	header._sourceRes = source->GetResolution();
+	header._count = _count;
+	header._endPosition = _endPosition;
+	header._eofPosition = source->CurrentPosition();
+	if (dataFormat!=NULL)
+	{
+		strncpy(header._dataFormat, dataFormat, sizeof(header._dataFormat)-1);
+	}
+	if (source->IsWaveFile())
+	{
+		CTapeReader* wave = (CTapeReader*)source;
+		header._avgCycleLength = wave->_avgCycleLength;
+		header._shortCycleLength = wave->_shortCycleLength;
+		header._longCycleLength = wave->_longCycleLength;
+		header._cycleLengthAllowance = wave->_cycleLengthAllowance;
+	}
+
+	bool ok = _ok && FlushChunk();
+	if (ok)
+		ok = fseek64(_file, 0, SEEK_SET)==0 && fwrite(&header, sizeof(header), 1, _file)==1;
+
+	if (fclose(_file)!=0)
+		ok = false;
+	_file = NULL;
+
+	if (!ok)
+		fprintf(stderr, "Failed to write binary dump file\n");
+
+	return ok;
+}
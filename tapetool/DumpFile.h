@@ -0,0 +1,85 @@
+//////////////////////////////////////////////////////////////////////////
+// DumpFile.h - declaration of CDumpWriter class
+
+#ifndef __DUMPFILE_H
+#define __DUMPFILE_H
+
+#include "FileReader.h"
+
+// Signature and version of binary dump files
+#define DUMP_FILE_SIG			0x504D4454
+#define DUMP_FILE_VERSION		2
+
+// File extension of binary dump files
+#define DUMP_FILE_EXTENSION		".tapedump"
+
+// Number of entries in each chunk (and so between absolute position checkpoints)
+#define DUMP_FILE_CHECKPOINT	256
+
+// Set in an entry's delta to mark where the original decode failed and had to
+// re-sync, rather than a piece of data
+#define DUMP_ENTRY_ERROR		0x80000000
+
+// A binary dump file is this header followed by chunks of up to
+// DUMP_FILE_CHECKPOINT entries (only the last chunk can be shorter), each:
+//
+//   int64					position of the chunk's first entry
+//   uint32[n]				position of each entry relative to the one before
+//							(DUMP_ENTRY_ERROR flags an error)
+//   int32[n] or
+//   uint8[n]				the entries (cycle lengths are 32-bit, everything else 8-bit)
+//
+// Chunks are written as they fill so the file can be streamed out, and the
+// header is filled in when it's closed.  Positions are in the units of the file
+// the data was decoded from (eg: samples for a wave file), so output from a
+// dump reports the same positions as the original.
+struct DUMP_FILE_HEADER
+{
+	int				_sig;
+	int				_version;
+	int				_headerSize;
+	int				_res;					// resolution of the entries
+	int				_sourceRes;				// resolution of the positions
+	int				_avgCycleLength;		// for classifying cycle lengths
+	int				_shortCycleLength;
+	int				_longCycleLength;
+	int				_cycleLengthAllowance;
+	int				_reserved;
+	int64			_count;
+	int64			_endPosition;			// position after the last entry
+	int64			_eofPosition;			// position after trying to read past it
+	char			_dataFormat[64];
+};
+
+// CDumpWriter - writes decoded data and its positions to a binary dump file
+class CDumpWriter
+{
+public:
+			CDumpWriter();
+	virtual ~CDumpWriter();
+
+	bool Create(const char* filename, Resolution res);
+	void Add(int64 position, int64 endPosition, int value);
+	void AddError(int64 position);
+	bool Close(CFileReader* source, const char* dataFormat);
+
+protected:
+	void AddEntry(int64 position, unsigned int flags, int value);
+	bool FlushChunk();
+
+	FILE*			_file;
+	Resolution		_res;
+	bool			_ok;
+	int64			_count;
+	int64			_lastPosition;
+	int64			_endPosition;
+
+	// The chunk being filled
+	int64			_chunkPosition;
+	int				_chunkCount;
+	unsigned int	_chunkDeltas[DUMP_FILE_CHECKPOINT];
+	int				_chunkValues[DUMP_FILE_CHECKPOINT];
+};
+
+#endif	// __DUMPFILE_H
+
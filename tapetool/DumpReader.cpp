@@ -0,0 +1,335 @@
+//////////////////////////////////////////////////////////////////////////
+// DumpReader.cpp - implementation of CDumpReader class
+
+#include "precomp.h"
+
+#include "DumpReader.h"
+
+CDumpReader::CDumpReader(CCommandStd* cmd) : CFileReader(cmd)
+{
+	_buffer = NULL;
+	_header = NULL;
+	_res = resNA;
+	_chunks = NULL;
+	_entrySize = 1;
+	_chunkSize = 0;
+	_index = 0;
+	_position = 0;
+	_lastCycleLen = 30;
+}
+
+CDumpReader::~CDumpReader()
+{
+	_map.Close();
+	free(_buffer);
+}
+
+static const char* ResolutionName(int res)
+{
+	switch (res)
+	{
+		case resCycles:
+			return "cycle lengths";
+
+		case resCycleKinds:
+			return "cycle kinds";
+
+		case resBits:
+			return "bits";
+
+		case resBytes:
+			return "bytes";
+	}
+
+	return "??";
+}
+
+bool CDumpReader::Open(const char* filename, Resolution res)
+{
+	// Map the file, or failing that read it all in
+	const unsigned char* data;
+	int64 length;
+	if (_map.Open(filename))
+	{
+		data = _map.GetData();
+		length = _map.GetLength();
+	}
+	else
+	{
+		FILE* file=fopen(filename,"rb");
+		if (file==NULL)
+		{
+			fprintf(stderr, "Could not open '%s' - %s (%i)\n", filename, strerror(errno), errno);
+			return false;
+		}
+
+		fseek64(file, 0, SEEK_END);
+		length = ftell64(file);
+		fseek64(file, 0, SEEK_SET);
+		_buffer = malloc((size_t)length + 1);
+		length = fread(_buffer, 1, (size_t)length, file);
+		fclose(file);
+		data = (const unsigned char*)_buffer;
+	}
+
+	// Check the header
+	_header = (const DUMP_FILE_HEADER*)data;
+	if (length < (int64)sizeof(DUMP_FILE_HEADER) || _header->_sig!=DUMP_FILE_SIG)
+	{
+		fprintf(stderr, "'%s' is not a binary dump file\n", filename);
+		return false;
+	}
+
+	if (_header->_version!=DUMP_FILE_VERSION || _header->_headerSize!=sizeof(DUMP_FILE_HEADER))
+	{
+		fprintf(stderr, "Binary dump '%s' is from a different version - please regenerate\n", filename);
+		return false;
+	}
+
+	// Check the length is right for the number of entries
+	int64 count = _header->_count;
+	_entrySize = _header->_res==resCycles ? 4 : 1;
+	_chunkSize = 8 + DUMP_FILE_CHECKPOINT * (4 + _entrySize);
+	int64 expected = (int64)sizeof(DUMP_FILE_HEADER) + (count / DUMP_FILE_CHECKPOINT) * _chunkSize;
+	if (count % DUMP_FILE_CHECKPOINT)
+		expected += 8 + (count % DUMP_FILE_CHECKPOINT) * (4 + _entrySize);
+	if (count<0 || length != expected)
+	{
+		fprintf(stderr, "Binary dump '%s' is corrupt\n", filename);
+		return false;
+	}
+
+	// Can only convert up from the stored resolution
+	_res = (Resolution)_header->_res;
+	if (res < _res)
+	{
+		fprintf(stderr, "Binary dump '%s' contains %s, which can't be read as %s\n", filename, ResolutionName(_res), ResolutionName(res));
+		return false;
+	}
+
+	_chunks = (const unsigned char*)(_header + 1);
+
+	_index = 0;
+	_position = count ? Checkpoint(0) : _header->_eofPosition;
+
+	// All good
+	return true;
+}
+
+const char* CDumpReader::GetDataFormat()
+{
+	return _header->_dataFormat[0] ? _header->_dataFormat : NULL;
+}
+
+Resolution CDumpReader::GetResolution()
+{
+	return _res;
+}
+
+void CDumpReader::Delete()
+{
+	delete this;
+}
+
+bool CDumpReader::IsWaveFile()
+{
+	return false;
+}
+
+int64 CDumpReader::CurrentPosition()
+{
+	return _position;
+}
+
+// Position of the first entry in a chunk
+int64 CDumpReader::Checkpoint(int64 chunk)
+{
+	return *(const int64*)(_chunks + chunk * _chunkSize);
+}
+
+// Position of an entry relative to the one before, and its flags
+unsigned int CDumpReader::Delta(int64 index)
+{
+	const unsigned char* chunk = _chunks + (index / DUMP_FILE_CHECKPOINT) * _chunkSize;
+	return ((const unsigned int*)(chunk + 8))[index % DUMP_FILE_CHECKPOINT];
+}
+
+int CDumpReader::Value(int64 index)
+{
+	// The values follow the chunk's deltas, which there are fewer of in the last chunk
+	int64 chunkIndex = index / DUMP_FILE_CHECKPOINT;
+	int64 inChunk = _header->_count - chunkIndex * DUMP_FILE_CHECKPOINT;
+	if (inChunk > DUMP_FILE_CHECKPOINT)
+		inChunk = DUMP_FILE_CHECKPOINT;
+
+	const unsigned char* values = _chunks + chunkIndex * _chunkSize + 8 + inChunk * 4;
+	int i = (int)(index % DUMP_FILE_CHECKPOINT);
+	return _entrySize==4 ? ((const int*)values)[i] : values[i];
+}
+
+// Read the next entry, or -1 at the end or where the original decode failed
+int CDumpReader::ReadEntry()
+{
+	// Failing to read moves to the end of the source file, the same as it did
+	if (_index >= _header->_count)
+	{
+		_position = _header->_eofPosition;
+		return -1;
+	}
+
+	bool error = (Delta(_index) & DUMP_ENTRY_ERROR)!=0;
+	int value = error ? -1 : Value(_index);
+
+	_index++;
+	_position = _index < _header->_count ? _position + (Delta(_index) & ~DUMP_ENTRY_ERROR) : _header->_endPosition;
+
+	return value;
+}
+
+// Move past any errors to the next piece of data (as re-syncing did originally),
+// returns false if there isn't one
+bool CDumpReader::SkipErrors()
+{
+	while (_index < _header->_count && (Delta(_index) & DUMP_ENTRY_ERROR)!=0)
+	{
+		_index++;
+		_position = _index < _header->_count ? _position + (Delta(_index) & ~DUMP_ENTRY_ERROR) : _header->_endPosition;
+	}
+
+	return _index < _header->_count;
+}
+
+int CDumpReader::ReadCycleLen()
+{
+	assert(_res==resCycles);
+
+	int len = ReadEntry();
+	if (len>=0)
+		_lastCycleLen = len;
+	return len;
+}
+
+char CDumpReader::ReadCycleKind()
+{
+	// Anything but cycle lengths is returned as is (as the text reader does)
+	if (_res!=resCycles)
+	{
+		int kind = ReadEntry();
+		return kind<0 ? 0 : (char)kind;
+	}
+
+	// Classify the same way as the wave file did
+	int iLen = ReadCycleLen();
+	if (iLen<0)
+		return 0;
+
+	const DUMP_FILE_HEADER* h = _header;
+	if (iLen < h->_shortCycleLength - h->_cycleLengthAllowance)
+		return '<';
+	if (iLen > h->_longCycleLength + h->_cycleLengthAllowance)
+		return '>';
+	if (iLen > h->_shortCycleLength + h->_cycleLengthAllowance && iLen < h->_longCycleLength - h->_cycleLengthAllowance)
+		return '?';
+
+	return iLen < h->_avgCycleLength ? 'S' : 'L';
+}
+
+// Move to the first entry at or after a position
+void CDumpReader::Seek(int64 position)
+{
+	int64 count = _header->_count;
+	if (count==0)
+		return;
+
+	// Find the last checkpoint at or before the position
+	int64 checkpointCount = (count + DUMP_FILE_CHECKPOINT - 1) / DUMP_FILE_CHECKPOINT;
+	int64 lo = 0;
+	int64 hi = checkpointCount - 1;
+	while (lo < hi)
+	{
+		int64 mid = (lo + hi + 1) / 2;
+		if (Checkpoint(mid) <= position)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	// Walk forward
+	_index = lo * DUMP_FILE_CHECKPOINT;
+	_position = Checkpoint(lo);
+	while (_position < position)
+	{
+		_index++;
+		if (_index >= count)
+		{
+			_position = _header->_endPosition;
+			break;
+		}
+		_position += Delta(_index) & ~DUMP_ENTRY_ERROR;
+	}
+}
+
+char* CDumpReader::FormatDuration(int64 duration)
+{
+	static char sz[512];
+
+	switch (_header->_sourceRes)
+	{
+		case resSamples:
+			sprintf(sz, "%lli samples", duration);
+			break;
+
+		case resCycleKinds:
+			sprintf(sz, "%lli cycles", duration);
+			break;
+
+		case resBits:
+			sprintf(sz, "%lli bits", duration);
+			break;
+
+		default:
+			sprintf(sz, "%lli bytes", duration);
+			break;
+	}
+
+	return sz;
+}
+
+int CDumpReader::LastCycleLen()
+{
+	return _lastCycleLen;
+}
+
+bool CDumpReader::SyncToBit(bool verbose)
+{
+	if (_res < resBits)
+		return __super::SyncToBit(verbose);
+	else
+		return SkipErrors();
+}
+
+int CDumpReader::ReadBit(bool verbose)
+{
+	if (_res < resBits)
+		return __super::ReadBit(verbose);
+
+	assert(_res==resBits);
+	return ReadEntry();
+}
+
+bool CDumpReader::SyncToByte(bool verbose)
+{
+	if (_res < resBytes)
+		return __super::SyncToByte(verbose);
+	else
+		return SkipErrors();
+}
+
+int CDumpReader::ReadByte(bool verbose)
+{
+	if (_res < resBytes)
+		return __super::ReadByte(verbose);
+
+	return ReadEntry();
+}
+
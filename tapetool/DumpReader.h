@@ -0,0 +1,56 @@
+//////////////////////////////////////////////////////////////////////////
+// DumpReader.h - declaration of CDumpReader class
+
+#ifndef __DUMPREADER_H
+#define __DUMPREADER_H
+
+#include "FileReader.h"
+#include "DumpFile.h"
+#include "MappedFile.h"
+
+// CDumpReader - reads data from a previously generated binary dump file
+class CDumpReader : public CFileReader
+{
+public:
+			CDumpReader(CCommandStd* cmd);
+	virtual ~CDumpReader();
+
+	virtual bool Open(const char* filename, Resolution res);
+	virtual const char* GetDataFormat();
+	virtual Resolution GetResolution();
+	virtual void Delete();
+	virtual bool IsWaveFile();
+	virtual int64 CurrentPosition();
+	virtual int ReadCycleLen();
+	virtual char ReadCycleKind();
+	virtual void Seek(int64 position);
+	virtual char* FormatDuration(int64 duration);
+	virtual int LastCycleLen();
+	virtual bool SyncToBit(bool verbose);
+	virtual int ReadBit(bool verbose = true);
+	virtual bool SyncToByte(bool verbose);
+	virtual int ReadByte(bool verbose=true);
+
+	int ReadEntry();
+	bool SkipErrors();
+	int64 Checkpoint(int64 chunk);
+	unsigned int Delta(int64 index);
+	int Value(int64 index);
+
+	CMappedFile _map;
+	void* _buffer;					// when read rather than mapped
+	const DUMP_FILE_HEADER* _header;
+	Resolution _res;
+	const unsigned char* _chunks;
+	int _entrySize;					// 4 for cycle lengths, otherwise 1
+	int64 _chunkSize;				// of all but the last chunk
+
+	// Read position
+	int64 _index;
+	int64 _position;
+	int _lastCycleLen;
+};
+
+
+#endif	// __DUMPREADER_H
+
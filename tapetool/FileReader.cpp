@@ -17,7 +17,7 @@ CFileReader::CFileReader(CCommandStd* cmd)
 
 char CFileReader::ReadCycleKindChecked(bool verbose)
 {
-	int pos = CurrentPosition();
+	int64 pos = CurrentPosition();
 	char kind = ReadCycleKind();
 
 	// Error?
@@ -29,7 +29,7 @@ char CFileReader::ReadCycleKindChecked(bool verbose)
 		}
 
 		if (verbose)
-			printf("[Invalid cycle kind '%c' - %i samples - at %i]", kind, LastCycleLen(), pos);
+			printf("[Invalid cycle kind '%c' - %i samples - at %lli]", kind, LastCycleLen(), pos);
 		return 0;
 	}
 
@@ -32,11 +32,11 @@ public:
 	virtual Resolution GetResolution()=0;
 	virtual void Delete()=0;
 	virtual bool IsWaveFile()=0;
-	virtual int CurrentPosition()=0;
+	virtual int64 CurrentPosition()=0;
 	virtual int ReadCycleLen()=0;
 	virtual char ReadCycleKind()=0;
-	virtual void Seek(int position)=0;
-	virtual char* FormatDuration(int duration)=0;
+	virtual void Seek(int64 position)=0;
+	virtual char* FormatDuration(int64 duration)=0;
 	virtual int LastCycleLen()=0;
 	virtual void Prepare() {};
 
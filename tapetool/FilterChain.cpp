@@ -0,0 +1,482 @@
+//////////////////////////////////////////////////////////////////////////
+// FilterChain.cpp - implementation of CFilterChain class
+
+#include "precomp.h"
+
+#include "FilterChain.h"
+
+// Use SSE for the data parallel stages where it's available at compile time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define FILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+// Stage names, as used in --dsp
+static const char* g_stageNames[] =
+{
+	"highpass",
+	"lowpass",
+	"bandpass",
+	"dcblock",
+	"agc",
+	"median",
+	"squarer",
+};
+
+//////////////////////////////////////////////////////////////////////////
+// CFilterChain
+
+// Constructor
+CFilterChain::CFilterChain()
+{
+	Clear();
+}
+
+// Destructor
+CFilterChain::~CFilterChain()
+{
+}
+
+// Parse a comma separated list of stages, each "name[=param[/q]]"
+// eg: "dcblock,bandpass=1800/0.7,agc=10,squarer"
+bool CFilterChain::Parse(const char* spec)
+{
+	Clear();
+	if (spec==NULL || spec[0]=='\0')
+		return true;
+
+	const char* p = spec;
+	while (true)
+	{
+		// Extract the next stage
+		const char* end = strchr(p, ',');
+		if (end==NULL)
+			end = p + strlen(p);
+
+		char stage[128];
+		int length = (int)(end - p);
+		if (length >= (int)sizeof(stage))
+			length = sizeof(stage) - 1;
+		memcpy(stage, p, length);
+		stage[length] = '\0';
+
+		char* param = strchr(stage, '=');
+		if (param!=NULL)
+			*param++ = '\0';
+		char* q = param==NULL ? NULL : strchr(param, '/');
+		if (q!=NULL)
+			*q++ = '\0';
+
+		// Look up the name
+		int kind = -1;
+		for (int i=0; i<(int)(sizeof(g_stageNames)/sizeof(g_stageNames[0])); i++)
+		{
+			if (_strcmpi(stage, g_stageNames[i])==0)
+				kind = i;
+		}
+		if (kind<0)
+		{
+			fprintf(stderr, "Unknown --dsp stage: `%s`\n", stage);
+			return false;
+		}
+
+		if (_stageCount == MAX_FILTER_STAGES)
+		{
+			fprintf(stderr, "Too many --dsp stages (max %i)\n", MAX_FILTER_STAGES);
+			return false;
+		}
+
+		// Defaults
+		FILTER_STAGE& s = _stages[_stageCount++];
+		memset(&s, 0, sizeof(s));
+		s._kind = (FilterStageKind)kind;
+		switch (s._kind)
+		{
+			case fsHighPass: s._param = 300; s._q = 0.7071; break;
+			case fsLowPass: s._param = 4000; s._q = 0.7071; break;
+			case fsBandPass: s._param = 1800; s._q = 0.7; break;
+			case fsDCBlock: s._param = 20; break;
+			case fsAGC: s._param = 10; break;
+			case fsMedian: s._param = 3; break;
+			case fsSquarer: s._param = 5; break;
+		}
+
+		if (param!=NULL && param[0]!='\0')
+			s._param = atof(param);
+		if (q!=NULL && q[0]!='\0')
+			s._q = atof(q);
+
+		if (s._param <= 0 || ((s._kind==fsHighPass || s._kind==fsLowPass || s._kind==fsBandPass) && s._q <= 0))
+		{
+			fprintf(stderr, "Invalid --dsp setting for %s\n", g_stageNames[kind]);
+			return false;
+		}
+		if (s._kind==fsMedian && s._param!=3 && s._param!=5)
+		{
+			fprintf(stderr, "--dsp median width must be 3 or 5\n");
+			return false;
+		}
+
+		// Include it in the hash
+		int values[3] = { kind, (int)(s._param * 1000), (int)(s._q * 1000) };
+		const unsigned char* bytes = (const unsigned char*)values;
+		for (int i=0; i<(int)sizeof(values); i++)
+			_hash = (_hash ^ bytes[i]) * 16777619;
+
+		if (*end=='\0')
+			break;
+		p = end + 1;
+	}
+
+	return true;
+}
+
+void CFilterChain::Clear()
+{
+	_stageCount = 0;
+	_sampleRate = 0;
+	_hash = 2166136261U;
+}
+
+bool CFilterChain::IsEmpty()
+{
+	return _stageCount==0;
+}
+
+// Hash of the stages and their settings, changes if anything affecting the
+// output changes
+unsigned int CFilterChain::GetHash()
+{
+	return _stageCount==0 ? 0 : _hash;
+}
+
+// Work out coefficients for the specified sample rate.  Range is the full scale
+// sample value, which the AGC and squarer levels are relative to.
+bool CFilterChain::Prepare(int sampleRate, int range)
+{
+	_sampleRate = sampleRate;
+
+	for (int i=0; i<_stageCount; i++)
+	{
+		FILTER_STAGE& s = _stages[i];
+		switch (s._kind)
+		{
+			case fsHighPass:
+			case fsLowPass:
+			case fsBandPass:
+			{
+				if (s._param >= sampleRate / 2)
+				{
+					fprintf(stderr, "--dsp %s frequency must be less than %iHz\n", g_stageNames[s._kind], sampleRate / 2);
+					return false;
+				}
+
+				// See "Cookbook formulae for audio EQ biquad filter coefficients" (Robert Bristow-Johnson)
+				double w0 = 2 * PI * s._param / sampleRate;
+				double cosw0 = cos(w0);
+				double alpha = sin(w0) / (2 * s._q);
+				double a0 = 1 + alpha;
+				double b0, b1, b2;
+				if (s._kind==fsHighPass)
+				{
+					b0 = (1 + cosw0) / 2;
+					b1 = -(1 + cosw0);
+					b2 = (1 + cosw0) / 2;
+				}
+				else if (s._kind==fsLowPass)
+				{
+					b0 = (1 - cosw0) / 2;
+					b1 = 1 - cosw0;
+					b2 = (1 - cosw0) / 2;
+				}
+				else
+				{
+					// Constant 0dB peak gain
+					b0 = alpha;
+					b1 = 0;
+					b2 = -alpha;
+				}
+				s._b0 = (float)(b0 / a0);
+				s._b1 = (float)(b1 / a0);
+				s._b2 = (float)(b2 / a0);
+				s._a1 = (float)(-2 * cosw0 / a0);
+				s._a2 = (float)((1 - alpha) / a0);
+				break;
+			}
+
+			case fsDCBlock:
+				s._a1 = (float)(1 - 2 * PI * s._param / sampleRate);
+				break;
+
+			case fsAGC:
+				s._attack = (float)(1 - exp(-1.0 / (sampleRate * 0.001)));
+				s._release = (float)(1 - exp(-1.0 / (sampleRate * s._param / 1000)));
+				s._target = (float)(range / 2);
+				break;
+
+			case fsMedian:
+				s._width = (int)s._param;
+				break;
+
+			case fsSquarer:
+				s._threshold = (float)(range * s._param / 100);
+				s._level = (float)(range / 2);
+				break;
+		}
+	}
+
+	Reset();
+	return true;
+}
+
+// Number of samples to run through the chain (after a Reset) before its output is valid
+int CFilterChain::GetWarmup()
+{
+	return _stageCount==0 ? 0 : _sampleRate * FILTER_WARMUP_MS / 1000;
+}
+
+// Clear the running state of each stage
+void CFilterChain::Reset()
+{
+	for (int i=0; i<_stageCount; i++)
+	{
+		FILTER_STAGE& s = _stages[i];
+		s._z1 = 0;
+		s._z2 = 0;
+		s._envelope = 0;
+		s._state = -1;
+		memset(s._history, 0, sizeof(s._history));
+	}
+}
+
+// Run samples through the chain, in place
+void CFilterChain::Process(int* samples, int count)
+{
+	while (count > 0)
+	{
+		int block = count < FILTER_BLOCK_SIZE ? count : FILTER_BLOCK_SIZE;
+		int i = 0;
+
+#ifdef FILTER_SSE2
+		for (; i+4<=block; i+=4)
+			_mm_storeu_ps(_block+i, _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(samples+i))));
+#endif
+		for (; i<block; i++)
+			_block[i] = (float)samples[i];
+
+		ProcessBlock(_block, block);
+
+		// Back to integers, clipping to the range of a 16-bit sample and rounding
+		// to nearest even (the same as the SSE conversion)
+		i = 0;
+#ifdef FILTER_SSE2
+		__m128 lo = _mm_set1_ps(-32768.0f);
+		__m128 hi = _mm_set1_ps(32767.0f);
+		for (; i+4<=block; i+=4)
+		{
+			__m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(_block+i), lo), hi);
+			_mm_storeu_si128((__m128i*)(samples+i), _mm_cvtps_epi32(x));
+		}
+#endif
+		for (; i<block; i++)
+		{
+			float x = _block[i];
+			if (x < -32768.0f)
+				x = -32768.0f;
+			if (x > 32767.0f)
+				x = 32767.0f;
+#ifdef FILTER_SSE2
+			samples[i] = _mm_cvtss_si32(_mm_set_ss(x));
+#else
+			samples[i] = (int)lrintf(x);
+#endif
+		}
+
+		samples += block;
+		count -= block;
+	}
+}
+
+void CFilterChain::ProcessBlock(float* x, int count)
+{
+	for (int i=0; i<_stageCount; i++)
+	{
+		FILTER_STAGE& s = _stages[i];
+		switch (s._kind)
+		{
+			case fsHighPass:
+			case fsLowPass:
+			case fsBandPass:
+				ProcessBiquad(s, x, count);
+				break;
+
+			case fsDCBlock:
+				ProcessDCBlock(s, x, count);
+				break;
+
+			case fsAGC:
+				ProcessAGC(s, x, count);
+				break;
+
+			case fsMedian:
+				ProcessMedian(s, x, count);
+				break;
+
+			case fsSquarer:
+				ProcessSquarer(s, x, count);
+				break;
+		}
+	}
+}
+
+// Recursive filters are inherently serial, but keeping the coefficients and
+// state in locals for the whole block keeps them in registers
+void CFilterChain::ProcessBiquad(FILTER_STAGE& s, float* x, int count)
+{
+	float b0 = s._b0, b1 = s._b1, b2 = s._b2, a1 = s._a1, a2 = s._a2;
+	float z1 = s._z1, z2 = s._z2;
+	for (int i=0; i<count; i++)
+	{
+		float in = x[i];
+		float out = b0 * in + z1;
+		z1 = b1 * in - a1 * out + z2;
+		z2 = b2 * in - a2 * out;
+		x[i] = out;
+	}
+	s._z1 = z1;
+	s._z2 = z2;
+}
+
+// y[n] = x[n] - x[n-1] + R * y[n-1]
+void CFilterChain::ProcessDCBlock(FILTER_STAGE& s, float* x, int count)
+{
+	float r = s._a1;
+	float prevIn = s._z1, prevOut = s._z2;
+	for (int i=0; i<count; i++)
+	{
+		float in = x[i];
+		prevOut = in - prevIn + r * prevOut;
+		prevIn = in;
+		x[i] = prevOut;
+	}
+	s._z1 = prevIn;
+	s._z2 = prevOut;
+}
+
+// Follow the signal's envelope (fast attack, slower release) and scale it
+// towards the target level
+void CFilterChain::ProcessAGC(FILTER_STAGE& s, float* x, int count)
+{
+	float* gain = _scratch;
+	float envelope = s._envelope;
+	float floorLevel = s._target / AGC_MAX_GAIN;
+	for (int i=0; i<count; i++)
+	{
+		float a = fabsf(x[i]);
+		envelope += (a > envelope ? s._attack : s._release) * (a - envelope);
+		gain[i] = s._target / (envelope > floorLevel ? envelope : floorLevel);
+	}
+	s._envelope = envelope;
+
+	int i = 0;
+#ifdef FILTER_SSE2
+	for (; i+4<=count; i+=4)
+		_mm_storeu_ps(x+i, _mm_mul_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(gain+i)));
+#endif
+	for (; i<count; i++)
+		x[i] *= gain[i];
+}
+
+// Median of 3 and 5 by min/max networks
+static inline float Median3(float a, float b, float c)
+{
+	float lo = a < b ? a : b;
+	float hi = a < b ? b : a;
+	float m = hi < c ? hi : c;
+	return lo > m ? lo : m;
+}
+
+static inline float Median5(float a, float b, float c, float d, float e)
+{
+	float minab = a < b ? a : b, maxab = a < b ? b : a;
+	float mincd = c < d ? c : d, maxcd = c < d ? d : c;
+	return Median3(e, minab > mincd ? minab : mincd, maxab < maxcd ? maxab : maxcd);
+}
+
+#ifdef FILTER_SSE2
+static inline __m128 Median3(__m128 a, __m128 b, __m128 c)
+{
+	return _mm_max_ps(_mm_min_ps(a, b), _mm_min_ps(_mm_max_ps(a, b), c));
+}
+#endif
+
+// Running median (removes clicks shorter than half the width).  Delays the
+// signal by half the width.
+void CFilterChain::ProcessMedian(FILTER_STAGE& s, float* x, int count)
+{
+	// Previous samples followed by this block
+	int history = s._width - 1;
+	float* ext = _scratch;
+	memcpy(ext, s._history, history * sizeof(float));
+	memcpy(ext + history, x, count * sizeof(float));
+
+	int i = 0;
+	if (s._width==3)
+	{
+#ifdef FILTER_SSE2
+		for (; i+4<=count; i+=4)
+			_mm_storeu_ps(x+i, Median3(_mm_loadu_ps(ext+i), _mm_loadu_ps(ext+i+1), _mm_loadu_ps(ext+i+2)));
+#endif
+		for (; i<count; i++)
+			x[i] = Median3(ext[i], ext[i+1], ext[i+2]);
+	}
+	else
+	{
+#ifdef FILTER_SSE2
+		for (; i+4<=count; i+=4)
+		{
+			__m128 a = _mm_loadu_ps(ext+i);
+			__m128 b = _mm_loadu_ps(ext+i+1);
+			__m128 c = _mm_loadu_ps(ext+i+2);
+			__m128 d = _mm_loadu_ps(ext+i+3);
+			__m128 e = _mm_loadu_ps(ext+i+4);
+			__m128 lo = _mm_max_ps(_mm_min_ps(a, b), _mm_min_ps(c, d));
+			__m128 hi = _mm_min_ps(_mm_max_ps(a, b), _mm_max_ps(c, d));
+			_mm_storeu_ps(x+i, Median3(e, lo, hi));
+		}
+#endif
+		for (; i<count; i++)
+			x[i] = Median5(ext[i], ext[i+1], ext[i+2], ext[i+3], ext[i+4]);
+	}
+
+	memcpy(s._history, ext + count, history * sizeof(float));
+}
+
+// Square the signal off, only switching level when it passes the threshold
+// in the other direction (so noise around zero doesn't cause extra edges)
+void CFilterChain::ProcessSquarer(FILTER_STAGE& s, float* x, int count)
+{
+	float state = s._state;
+	for (int i=0; i<count; i++)
+	{
+		if (x[i] > s._threshold)
+			state = 1;
+		else if (x[i] < -s._threshold)
+			state = -1;
+		x[i] = state * s._level;
+	}
+	s._state = state;
+}
+
+void CFilterChain::ShowHelp()
+{
+	printf("  --dsp:stages          process the input through a comma separated list of stages:\n");
+	printf("                             'highpass[=Hz[/Q]]' = biquad high pass (300Hz)\n");
+	printf("                             'lowpass[=Hz[/Q]]' = biquad low pass (4000Hz)\n");
+	printf("                             'bandpass[=Hz[/Q]]' = biquad band pass (1800Hz, Q=0.7)\n");
+	printf("                             'dcblock[=Hz]' = remove DC offset (20Hz)\n");
+	printf("                             'agc[=ms]' = automatic gain control, release time (10ms)\n");
+	printf("                             'median[=3|5]' = de-click with a running median (3)\n");
+	printf("                             'squarer[=%%]' = square off with hysteresis, threshold as %% of full scale (5%%)\n");
+}
+
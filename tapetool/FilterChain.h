@@ -0,0 +1,98 @@
+//////////////////////////////////////////////////////////////////////////
+// FilterChain.h - declaration of CFilterChain class
+
+#ifndef __FILTERCHAIN_H
+#define __FILTERCHAIN_H
+
+// Most stages in a chain
+#define MAX_FILTER_STAGES	16
+
+// Samples processed at a time
+#define FILTER_BLOCK_SIZE	4096
+
+// Milliseconds of signal run through the chain before the position sought to
+// so that its state has settled
+#define FILTER_WARMUP_MS	20
+
+// Largest gain the AGC stage will apply (so silence isn't amplified into noise)
+#define AGC_MAX_GAIN		100
+
+// Kinds of filter chain stage
+enum FilterStageKind
+{
+	fsHighPass,
+	fsLowPass,
+	fsBandPass,
+	fsDCBlock,
+	fsAGC,
+	fsMedian,
+	fsSquarer,
+};
+
+// One stage of a filter chain - its settings, coefficients and running state
+struct FILTER_STAGE
+{
+	FilterStageKind	_kind;
+	double			_param;			// frequency (Hz), time (ms), width or threshold (%)
+	double			_q;				// biquads only
+
+	// Biquad coefficients (normalised, so a0 is 1) and transposed direct form II state.
+	// The DC blocker uses _a1 as its pole and _z1/_z2 as the previous input/output
+	float			_b0, _b1, _b2, _a1, _a2;
+	float			_z1, _z2;
+
+	// AGC
+	float			_attack;
+	float			_release;
+	float			_envelope;
+	float			_target;
+
+	// Median - the previous (width - 1) samples
+	int				_width;
+	float			_history[4];
+
+	// Squarer
+	float			_threshold;
+	float			_level;
+	float			_state;
+};
+
+// CFilterChain - a series of processing stages applied to blocks of samples,
+// used to clean up a signal before it's decoded (--dsp)
+class CFilterChain
+{
+public:
+			CFilterChain();
+	virtual ~CFilterChain();
+
+	bool Parse(const char* spec);
+	void Clear();
+	bool IsEmpty();
+	unsigned int GetHash();
+	bool Prepare(int sampleRate, int range);
+	int GetWarmup();
+	void Reset();
+	void Process(int* samples, int count);
+
+	static void ShowHelp();
+
+protected:
+	void ProcessBlock(float* x, int count);
+	void ProcessBiquad(FILTER_STAGE& s, float* x, int count);
+	void ProcessDCBlock(FILTER_STAGE& s, float* x, int count);
+	void ProcessAGC(FILTER_STAGE& s, float* x, int count);
+	void ProcessMedian(FILTER_STAGE& s, float* x, int count);
+	void ProcessSquarer(FILTER_STAGE& s, float* x, int count);
+
+	FILTER_STAGE _stages[MAX_FILTER_STAGES];
+	int _stageCount;
+	int _sampleRate;
+	unsigned int _hash;
+
+	// Working buffers
+	float _block[FILTER_BLOCK_SIZE];
+	float _scratch[FILTER_BLOCK_SIZE + 4];
+};
+
+#endif	// __FILTERCHAIN_H
+
@@ -0,0 +1,193 @@
+//////////////////////////////////////////////////////////////////////////
+// FskDemodulator.cpp - implementation of CFskDemodulator class
+
+#include "precomp.h"
+
+#include "FskDemodulator.h"
+#include "WaveReader.h"
+
+// Use SSE for the correlations where it's available at compile time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define DEMOD_SSE2
+#include <emmintrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// CFskDemodulator
+
+// Constructor
+CFskDemodulator::CFskDemodulator()
+{
+	_templates = NULL;
+	Close();
+}
+
+// Destructor
+CFskDemodulator::~CFskDemodulator()
+{
+	Close();
+}
+
+// Build the matched filters for the specified short and long cycle lengths
+// (in samples).  The window is one long cycle.  When the long cycle is twice
+// the short (as recorded) that's a whole number of cycles of both tones, so
+// they don't leak into each other.
+bool CFskDemodulator::Setup(int shortCycleLength, int longCycleLength)
+{
+	Close();
+
+	if (shortCycleLength < 2 || longCycleLength <= shortCycleLength || longCycleLength > SAMPLE_BLOCK_SIZE / 2)
+		return false;
+
+	_templates = (float*)malloc(4 * longCycleLength * sizeof(float));
+	if (_templates==NULL)
+		return false;
+
+	_shortCycleLength = shortCycleLength;
+	_longCycleLength = longCycleLength;
+	_window = longCycleLength;
+	_shortCos = _templates;
+	_shortSin = _shortCos + _window;
+	_longCos = _shortSin + _window;
+	_longSin = _longCos + _window;
+
+	for (int i=0; i<_window; i++)
+	{
+		double shortAngle = 2 * PI * i / shortCycleLength;
+		double longAngle = 2 * PI * i / longCycleLength;
+		_shortCos[i] = (float)cos(shortAngle);
+		_shortSin[i] = (float)sin(shortAngle);
+		_longCos[i] = (float)cos(longAngle);
+		_longSin[i] = (float)sin(longAngle);
+	}
+
+	return true;
+}
+
+void CFskDemodulator::Close()
+{
+	if (_templates!=NULL)
+		free(_templates);
+
+	_templates = NULL;
+	_shortCos = NULL;
+	_shortSin = NULL;
+	_longCos = NULL;
+	_longSin = NULL;
+	_shortCycleLength = 0;
+	_longCycleLength = 0;
+	_window = 0;
+}
+
+bool CFskDemodulator::IsOpen()
+{
+	return _templates!=NULL;
+}
+
+// Number of samples Demodulate needs
+int CFskDemodulator::GetWindowLength()
+{
+	return _window;
+}
+
+// Longest step Demodulate can return, rounded up.  A tone's step is corrected
+// by up to DEMOD_PHASE_GAIN of half a cycle.
+int CFskDemodulator::GetMaxStep()
+{
+	return (int)ceil(_longCycleLength * (1 + DEMOD_PHASE_GAIN / 2));
+}
+
+// Classify the cycle starting at the first of GetWindowLength() samples as
+// 'S', 'L', '?' (both tones present, typically at a bit boundary) or '>' (no
+// tone, ie: silence or noise).  Step is set to where the next cycle starts,
+// relative to this one.  For a clear tone this is nudged towards where the
+// tone's phase says its cycles actually start, so we stay locked to the signal
+// even though the cycle lengths are only approximate.
+char CFskDemodulator::Demodulate(const int* samples, double& step)
+{
+	// Correlate the window with each template, and measure its total power
+	float sc, ss, lc, ls, power;
+	int i = 0;
+
+#ifdef DEMOD_SSE2
+	__m128 vsc = _mm_setzero_ps();
+	__m128 vss = _mm_setzero_ps();
+	__m128 vlc = _mm_setzero_ps();
+	__m128 vls = _mm_setzero_ps();
+	__m128 vpower = _mm_setzero_ps();
+	for (; i+4<=_window; i+=4)
+	{
+		__m128 x = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(samples+i)));
+		vsc = _mm_add_ps(vsc, _mm_mul_ps(x, _mm_loadu_ps(_shortCos+i)));
+		vss = _mm_add_ps(vss, _mm_mul_ps(x, _mm_loadu_ps(_shortSin+i)));
+		vlc = _mm_add_ps(vlc, _mm_mul_ps(x, _mm_loadu_ps(_longCos+i)));
+		vls = _mm_add_ps(vls, _mm_mul_ps(x, _mm_loadu_ps(_longSin+i)));
+		vpower = _mm_add_ps(vpower, _mm_mul_ps(x, x));
+	}
+
+	float lanes[5][4];
+	_mm_storeu_ps(lanes[0], vsc);
+	_mm_storeu_ps(lanes[1], vss);
+	_mm_storeu_ps(lanes[2], vlc);
+	_mm_storeu_ps(lanes[3], vls);
+	_mm_storeu_ps(lanes[4], vpower);
+	sc = lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3];
+	ss = lanes[1][0] + lanes[1][1] + lanes[1][2] + lanes[1][3];
+	lc = lanes[2][0] + lanes[2][1] + lanes[2][2] + lanes[2][3];
+	ls = lanes[3][0] + lanes[3][1] + lanes[3][2] + lanes[3][3];
+	power = lanes[4][0] + lanes[4][1] + lanes[4][2] + lanes[4][3];
+#else
+	sc = ss = lc = ls = power = 0;
+#endif
+
+	for (; i<_window; i++)
+	{
+		float x = (float)samples[i];
+		sc += x * _shortCos[i];
+		ss += x * _shortSin[i];
+		lc += x * _longCos[i];
+		ls += x * _longSin[i];
+		power += x * x;
+	}
+
+	float shortEnergy = sc * sc + ss * ss;
+	float longEnergy = lc * lc + ls * ls;
+
+	// A pure tone puts power * _window / 2 into its filter
+	if (power <= 0 || shortEnergy + longEnergy < DEMOD_MIN_TONE * power * _window / 2)
+	{
+		step = _longCycleLength;
+		return '>';
+	}
+
+	int cycleLength;
+	float c, s;
+	char kind;
+	if (shortEnergy > DEMOD_TONE_RATIO * longEnergy)
+	{
+		cycleLength = _shortCycleLength;
+		c = sc;
+		s = ss;
+		kind = 'S';
+	}
+	else if (longEnergy > DEMOD_TONE_RATIO * shortEnergy)
+	{
+		cycleLength = _longCycleLength;
+		c = lc;
+		s = ls;
+		kind = 'L';
+	}
+	else
+	{
+		step = (_shortCycleLength + _longCycleLength) / 2.0;
+		return '?';
+	}
+
+	// For sin(w(n - offset)) the correlations are c = -sin(w * offset) and
+	// s = cos(w * offset) (scaled), giving the offset of the cycle's start
+	// within half a cycle either side of the window's start
+	double offset = atan2(-c, s) * cycleLength / (2 * PI);
+	step = cycleLength + offset * DEMOD_PHASE_GAIN;
+	return kind;
+}
+
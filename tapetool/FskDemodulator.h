@@ -0,0 +1,47 @@
+//////////////////////////////////////////////////////////////////////////
+// FskDemodulator.h - declaration of CFskDemodulator class
+
+#ifndef __FSKDEMODULATOR_H
+#define __FSKDEMODULATOR_H
+
+// One tone must have this much more energy than the other to decide a cycle kind
+#define DEMOD_TONE_RATIO	2.0f
+
+// Fraction of a window's power that must be in the two tones for it not to be noise
+#define DEMOD_MIN_TONE		0.2f
+
+// How much of the measured phase error is corrected on each step
+#define DEMOD_PHASE_GAIN	0.5
+
+// CFskDemodulator - classifies cycles by comparing the energy of the short and
+// long cycle tones over a window of samples (matched filters at the two
+// frequencies) rather than by timing zero crossings, so a noisy crossing
+// doesn't split a cycle in two.
+class CFskDemodulator
+{
+public:
+			CFskDemodulator();
+	virtual ~CFskDemodulator();
+
+	bool Setup(int shortCycleLength, int longCycleLength);
+	void Close();
+	bool IsOpen();
+	int GetWindowLength();
+	int GetMaxStep();
+	char Demodulate(const int* samples, double& step);
+
+protected:
+	int _shortCycleLength;
+	int _longCycleLength;
+	int _window;			// one long cycle
+
+	// Sine and cosine templates for each tone, _window samples each
+	float* _templates;
+	float* _shortCos;
+	float* _shortSin;
+	float* _longCos;
+	float* _longSin;
+};
+
+#endif	// __FSKDEMODULATOR_H
+
@@ -90,20 +90,20 @@ void CInstrumentation::EnsureSection(int speed)
 	_currentSection->_speed=speed;
 }
 
-void CInstrumentation::AddBitEntry(int speed, int bit, int offset, int end_offset)
+void CInstrumentation::AddBitEntry(int speed, int bit, int64 offset, int64 end_offset)
 {
 	if (_res == resBits)
 		AddEntryRaw(speed, (char)bit, offset, end_offset);
 }
 
-void CInstrumentation::AddCycleKindEntry(char kind, int offset, int end_offset)
+void CInstrumentation::AddCycleKindEntry(char kind, int64 offset, int64 end_offset)
 {
 	if (_res == resCycleKinds)
 		AddEntryRaw(0, kind, offset, end_offset);
 }
 
 // Add an entry to the current section
-void CInstrumentation::AddEntryRaw(int speed, char kind, int offset, int end_offset)
+void CInstrumentation::AddEntryRaw(int speed, char kind, int64 offset, int64 end_offset)
 {
 	// Ignore if section not start
 	if (_inResync)
@@ -120,7 +120,7 @@ void CInstrumentation::AddEntryRaw(int speed, char kind, int offset, int end_off
 	_pendingEndOffset = end_offset;
 }
 
-void CInstrumentation::AddEntryInternal(char kind, int offset)
+void CInstrumentation::AddEntryInternal(char kind, int64 offset)
 {
 	// Make room for new entry
 	if (_entryCount+1 >= _allocatedEntryCount)
@@ -169,6 +169,7 @@ void CInstrumentation::Reset()
 
 	_entries = NULL;
 	_sections= NULL;
+	_packedKinds.Clear();
 	_sectionCount = 0;
 	_entryCount = 0;
 	_allocatedEntryCount = 0;
@@ -176,7 +177,7 @@ void CInstrumentation::Reset()
 	_pendingEndOffset = 0;
 }
 
-bool CInstrumentation::Save(const char* filename, int checkVal)
+bool CInstrumentation::Save(const char* filename, int64 checkVal)
 {
 	SectionBreak();
 	/*
@@ -216,7 +217,7 @@ bool CInstrumentation::Save(const char* filename, int checkVal)
 
 	// Write header
 	INSTR_FILE header;
-	header._sig = 0x92748123;
+	header._sig = INSTR_FILE_SIG;
 	header._sectionCount = _sectionCount;
 	header._entryCount = _entryCount;
 	header._check = checkVal;
@@ -235,7 +236,7 @@ bool CInstrumentation::Save(const char* filename, int checkVal)
 	return true;
 }
 
-bool CInstrumentation::SaveText(const char* filename, int checkVal)
+bool CInstrumentation::SaveText(const char* filename, int64 checkVal)
 {
 	FILE* file = fopen(filename, "wt");
 	if (file==NULL)
@@ -244,7 +245,7 @@ bool CInstrumentation::SaveText(const char* filename, int checkVal)
 		return false;
 	}
 
-	fprintf(file, "check:%i\n", checkVal);
+	fprintf(file, "check:%lli\n", checkVal);
 	fprintf(file, "resolution:%s\n", GetResolutionString());
 
 	for (int i=0; i<_sectionCount; i++)
@@ -254,10 +255,10 @@ bool CInstrumentation::SaveText(const char* filename, int checkVal)
 		for (int j=0; j<sect->_entryCount; j++)
 		{
 			INSTR_ENTRY* entry = &_entries[sect->_firstEntry + j];
-			fprintf(file, "  %i:%i", entry->_offset, entry->_kind);
+			fprintf(file, "  %lli:%i", entry->_offset, entry->_kind);
 			if (entry->_kind!=-1)
 			{
-				fprintf(file, " (%i)", entry[1]._offset - entry->_offset);
+				fprintf(file, " (%lli)", entry[1]._offset - entry->_offset);
 			}
 			fprintf(file, "\n");
 		}
@@ -270,7 +271,7 @@ bool CInstrumentation::SaveText(const char* filename, int checkVal)
 }
 
 
-bool CInstrumentation::Load(const char* filename, int checkVal)
+bool CInstrumentation::Load(const char* filename, int64 checkVal)
 {
 	FILE* file = fopen(filename, "rb");
 	if (file==NULL)
@@ -287,6 +288,14 @@ bool CInstrumentation::Load(const char* filename, int checkVal)
 		return false;
 	}
 
+	// Check the signature
+	if (header._sig!=(int)INSTR_FILE_SIG)
+	{
+		fprintf(stderr, "Profile data is from an older version - please regenerate");
+		fclose(file);
+		return false;
+	}
+
 	// Check the check val
 	if (header._check!=checkVal)
 	{
@@ -328,11 +337,31 @@ bool CInstrumentation::Load(const char* filename, int checkVal)
 	return true;
 }
 
-bool CInstrumentation::FindSequence(int speed, char* kinds, int count, INSTR_ENTRY** pStart, int* pLength)
+// Bits or cycle kinds are packed to be matched a word at a time
+int CInstrumentation::GetPackedBitsPerEntry()
+{
+	return _res==resCycleKinds ? PACKED_CYCLEKINDS : PACKED_BITS;
+}
+
+int CInstrumentation::PackKind(char kind)
+{
+	return _res==resCycleKinds ? CPackedArray::PackCycleKind(kind) : (kind & 1);
+}
+
+bool CInstrumentation::FindSequence(int speed, CPackedArray& kinds, int offset, int count, INSTR_ENTRY** pStart, int* pLength)
 {
 	int length = 0;
 	INSTR_ENTRY* start = NULL;
 
+	// Pack the entries on first use
+	if (_packedKinds.GetLength()!=_entryCount)
+	{
+		_packedKinds.Init(GetPackedBitsPerEntry());
+		for (int i=0; i<_entryCount; i++)
+		{
+			_packedKinds.Add(PackKind(_entries[i]._kind));
+		}
+	}
 
 	for (int iSection = 0; iSection<_sectionCount; iSection++)
 	{
@@ -340,42 +369,20 @@ bool CInstrumentation::FindSequence(int speed, char* kinds, int count, INSTR_ENT
 
 		if (sect->_speed!=speed)
 			continue;
+
+		// The terminating entry never matches (and doesn't pack as a bit)
+		int matchable = sect->_entryCount;
+		if (matchable>0 && _entries[sect->_firstEntry + matchable - 1]._kind==-1)
+			matchable--;
 		
 		for (int i=0; i<sect->_entryCount; i++)
 		{
 			// Find first mismatch
-			int j;
-			for (j=0; j<sect->_entryCount-i && j<count; j++)
+			int j = 0;
+			if (i<matchable)
 			{
-				// Same cycle kind
-				if (_entries[sect->_firstEntry + i + j]._kind==kinds[j])
-					continue;
-
-				// Did we instrument an ambiguous cycle
-				/*
-				if (_entries[sect->_firstEntry + i + j]._kind=='?')
-				{
-					// Get the next and previous cycle kind
-					char prev = i+j>0 ? _entries[sect->_firstEntry + i + j - 1]._kind : 0;
-					char next = i+j+1<sect->_entryCount ? _entries[sect->_firstEntry + i + j + 1]._kind : 0;
-
-					// Is the ambiguous cycle is on S->?->L or L->?->S boundary
-					if ((prev=='L' || prev=='S') && (next=='S' || next=='L') && prev!=next)
-					{
-						if (j+1==count || next == kinds[j+1])
-							continue;
-					}
-				}
-
-				// Allow skipping one cycle
-				if (next == kinds[j])
-				{
-					continue;
-				}
-				*/
-
-				// Mismatch
-				break;
+				int limit = matchable - i < count ? matchable - i : count;
+				j = (int)CPackedArray::CountMatching(_packedKinds, sect->_firstEntry + i, kinds, offset, limit);
 			}
 
 			// New best sequence?
@@ -424,12 +431,12 @@ bool CInstrumentation::FindSequence(int speed, char* kinds, int count, INSTR_ENT
 }
 
 
-int CInstrumentation::LeadingSampleCount()
+int64 CInstrumentation::LeadingSampleCount()
 {
 	return _entries[0]._offset;
 }
 
-int CInstrumentation::TrailingSamplesOffset()
+int64 CInstrumentation::TrailingSamplesOffset()
 {
 	return _entries[_entryCount-1]._offset;
 }
@@ -4,12 +4,17 @@
 #ifndef __INSTRUMENTATION_H
 #define __INSTRUMENTATION_H
 
+#include "PackedArray.h"
+
 enum Resolution;
 
+// Signature of binary profile files (changed when offsets went to 64-bit)
+#define INSTR_FILE_SIG	0x92748124
+
 struct INSTR_ENTRY
 {
 	char			_kind;			// Bit: 0, 1
-	int				_offset;
+	int64			_offset;
 	bool			_used;
 };
 
@@ -25,7 +30,7 @@ struct INSTR_FILE
 	int				_sig;
 	int				_sectionCount;
 	int				_entryCount;
-	int				_check;
+	int64			_check;
 	Resolution		_res;
 };
 
@@ -40,9 +45,9 @@ public:
 	const char* GetResolutionString();
 
 	void SectionBreak();
-	void AddBitEntry(int speed, int bit, int offset, int end_offset);
-	void AddCycleKindEntry(char kind, int offset, int end_offset);
-	void AddEntryRaw(int speed, char kind, int offset, int end_offset);
+	void AddBitEntry(int speed, int bit, int64 offset, int64 end_offset);
+	void AddCycleKindEntry(char kind, int64 offset, int64 end_offset);
+	void AddEntryRaw(int speed, char kind, int64 offset, int64 end_offset);
 	void StartSync();
 	void EndSync();
 	int GetTotalEntries();
@@ -56,21 +61,24 @@ public:
 	int				_entryCount;
 	int				_allocatedEntryCount;
 	int				_inResync;
-	int				_pendingEndOffset;
+	int64			_pendingEndOffset;
 	int				_totalUsed;
+	CPackedArray	_packedKinds;		// entry kinds, for matching
 
 	void Reset();
-	bool Save(const char* filename, int checkVal);
-	bool SaveText(const char* filename, int checkVal);
-	bool Load(const char* filename, int checkVal);
+	bool Save(const char* filename, int64 checkVal);
+	bool SaveText(const char* filename, int64 checkVal);
+	bool Load(const char* filename, int64 checkVal);
 
-	bool FindSequence(int speed, char* kinds, int count, INSTR_ENTRY** pStart, int* pLength);
-	int LeadingSampleCount();
-	int TrailingSamplesOffset();
+	int GetPackedBitsPerEntry();
+	int PackKind(char kind);
+	bool FindSequence(int speed, CPackedArray& kinds, int offset, int count, INSTR_ENTRY** pStart, int* pLength);
+	int64 LeadingSampleCount();
+	int64 TrailingSamplesOffset();
 
 private:
 	void EnsureSection(int speed);
-	void AddEntryInternal(char kind, int offset);
+	void AddEntryInternal(char kind, int64 offset);
 };
 
 
@@ -4,11 +4,103 @@
 #include "precomp.h"
 
 #include "MachineType.h"
+#include "Instrumentation.h"
 
 CMachineType::CMachineType()
 {
+	_cacheReader = NULL;
+	_bitCache = NULL;
+	_byteCache = NULL;
+	memset(&_bitCacheStats, 0, sizeof(_bitCacheStats));
+	memset(&_byteCacheStats, 0, sizeof(_byteCacheStats));
 }
 
 CMachineType::~CMachineType()
 {
+	free(_bitCache);
+	free(_byteCache);
+}
+
+int CMachineType::ReadBit(CFileReader* reader, bool verbose)
+{
+	return CachedDecode(reader, verbose, _bitCache, _bitCacheStats, true);
+}
+
+int CMachineType::ReadByte(CFileReader* reader, bool verbose)
+{
+	return CachedDecode(reader, verbose, _byteCache, _byteCacheStats, false);
+}
+
+// Decode a bit or byte, or if it's been decoded from the same position recently
+// re-use that result and move the reader to where it ended.
+//
+// Only wave input is cached (everything else is cheap to decode) and only
+// non-verbose reads are served from the cache since verbose decoding reports
+// errors as it goes.  Instrumented reads aren't cached at all as they record
+// each bit as it's decoded.
+int CMachineType::CachedDecode(CFileReader* reader, bool verbose, DECODE_CACHE_ENTRY*& cache, DECODE_CACHE_STATS& stats, bool bits)
+{
+	if (!reader->IsWaveFile() || reader->GetInstrumentation()!=NULL)
+		return bits ? DecodeBit(reader, verbose) : DecodeByte(reader, verbose);
+
+	// Positions are only meaningful for one reader
+	if (reader!=_cacheReader)
+	{
+		ResetDecodeCache();
+		_cacheReader = reader;
+	}
+
+	if (cache==NULL)
+	{
+		cache = (DECODE_CACHE_ENTRY*)malloc(DECODE_CACHE_SIZE * sizeof(DECODE_CACHE_ENTRY));
+		if (cache==NULL)
+			return bits ? DecodeBit(reader, verbose) : DecodeByte(reader, verbose);
+		for (int i=0; i<DECODE_CACHE_SIZE; i++)
+			cache[i]._start = -1;
+	}
+
+	int64 start = reader->CurrentPosition();
+	DECODE_CACHE_ENTRY* e = cache + (int)((unsigned long long)(start * 0x9E3779B97F4A7C15ULL) >> 52) % DECODE_CACHE_SIZE;
+	if (!verbose && e->_start==start)
+	{
+		stats._hits++;
+		reader->Seek(e->_end);
+		return e->_value;
+	}
+
+	stats._misses++;
+	int value = bits ? DecodeBit(reader, verbose) : DecodeByte(reader, verbose);
+	e->_start = start;
+	e->_end = reader->CurrentPosition();
+	e->_value = value;
+	return value;
+}
+
+// Discard cached results but keep counting hits and misses (eg: after
+// something that changes how bits are decoded, like the speed)
+void CMachineType::InvalidateDecodeCache()
+{
+	free(_bitCache);
+	free(_byteCache);
+	_bitCache = NULL;
+	_byteCache = NULL;
+}
+
+// Report how much re-decoding the cache saved
+void CMachineType::ShowDecodeCacheStats()
+{
+	if (_cacheReader==NULL)
+		return;
+
+	printf("\n[decode cache: bits %lli hits %lli misses, bytes %lli hits %lli misses]\n",
+			_bitCacheStats._hits, _bitCacheStats._misses, _byteCacheStats._hits, _byteCacheStats._misses);
+}
+
+// Discard everything cached (must be called before the reader is closed)
+void CMachineType::ResetDecodeCache()
+{
+	InvalidateDecodeCache();
+	_cacheReader = NULL;
+	memset(&_bitCacheStats, 0, sizeof(_bitCacheStats));
+	memset(&_byteCacheStats, 0, sizeof(_byteCacheStats));
 }
\ No newline at end of file
@@ -14,6 +14,25 @@ class CContext;
 // Command handler
 typedef int (*fnCmd)(CContext*);
 
+// Number of entries in each of the bit and byte decode caches (power of 2)
+#define DECODE_CACHE_SIZE	4096
+
+// A previously decoded bit or byte, by where it started.  _value is -1 if it
+// couldn't be decoded, _end is where the reader was left either way
+struct DECODE_CACHE_ENTRY
+{
+	int64	_start;
+	int64	_end;
+	int		_value;
+};
+
+// Hit/miss counts for one of the decode caches
+struct DECODE_CACHE_STATS
+{
+	int64	_hits;
+	int64	_misses;
+};
+
 class CMachineType
 {
 public:
@@ -29,9 +48,19 @@ public:
 	virtual void PrepareWaveMetrics(CCommandStd* c, CTapeReader* wave)=0;
 
 	virtual bool SyncToBit(CFileReader* reader, bool verbose)=0;
-	virtual int ReadBit(CFileReader* reader, bool verbose)=0;
 	virtual bool SyncToByte(CFileReader* reader, bool verbose)=0;
-	virtual int ReadByte(CFileReader* reader, bool verbose)=0;
+
+	// Read a bit or byte, from the decode cache when re-reading somewhere recently
+	// decoded (eg: after the sync routines rewind)
+	int ReadBit(CFileReader* reader, bool verbose);
+	int ReadByte(CFileReader* reader, bool verbose);
+	void ShowDecodeCacheStats();
+	void ResetDecodeCache();
+	void InvalidateDecodeCache();
+
+	// Decode a bit or byte from the reader's current position
+	virtual int DecodeBit(CFileReader* reader, bool verbose)=0;
+	virtual int DecodeByte(CFileReader* reader, bool verbose)=0;
 
 	virtual void RenderCycleKind(CWaveWriter* writer, char kind)=0;
 	virtual void RenderBit(CWaveWriter* writer, unsigned char bit)=0;
@@ -41,6 +70,16 @@ public:
 	virtual bool InitWaveWriterProfiled(CWaveWriterProfiled* w) { return false; }
 
 	virtual bool CanRenderSquare() { return false; }
+	virtual bool CanDemodulate() { return false; }
+
+protected:
+	int CachedDecode(CFileReader* reader, bool verbose, DECODE_CACHE_ENTRY*& cache, DECODE_CACHE_STATS& stats, bool bits);
+
+	CFileReader* _cacheReader;
+	DECODE_CACHE_ENTRY* _bitCache;
+	DECODE_CACHE_ENTRY* _byteCache;
+	DECODE_CACHE_STATS _bitCacheStats;
+	DECODE_CACHE_STATS _byteCacheStats;
 };
 
 #endif	// __MACHINETYPE_H
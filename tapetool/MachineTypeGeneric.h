@@ -33,7 +33,7 @@ public:
 		return false;
 	}
 
-	virtual int ReadBit(CFileReader* reader, bool verbose)
+	virtual int DecodeBit(CFileReader* reader, bool verbose)
 	{
 		return -1;
 	}
@@ -43,7 +43,7 @@ public:
 		return false;
 	}
 
-	virtual int ReadByte(CFileReader* reader, bool verbose)
+	virtual int DecodeByte(CFileReader* reader, bool verbose)
 	{
 		return -1;
 	}
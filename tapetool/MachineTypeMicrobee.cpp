@@ -58,7 +58,7 @@ bool CMachineTypeMicrobee::SyncToBit(CFileReader* reader, bool verbose)
 		printf("[BitSync:");
 
 	char buf[3];
-	int offs[3];
+	int64 offs[3];
 	int cyclesRead = 0;
 
 	buf[0]='?';
@@ -70,7 +70,7 @@ bool CMachineTypeMicrobee::SyncToBit(CFileReader* reader, bool verbose)
 
 	while (true)
 	{
-		int cycleStart = reader->CurrentPosition();
+		int64 cycleStart = reader->CurrentPosition();
 
 		// Read the next cycle kind
 		char kind = reader->ReadCycleKind();
@@ -98,7 +98,7 @@ bool CMachineTypeMicrobee::SyncToBit(CFileReader* reader, bool verbose)
 		// Found a boundary?
 		if ((buf[0]=='S' && buf[2]=='L') || (buf[0]=='L' && buf[2]=='S'))
 		{
-			int savePos = reader->CurrentPosition();
+			int64 savePos = reader->CurrentPosition();
 
 			int boundary = (buf[1]=='?' || buf[1]==buf[2]) ? 1 : 2;
 
@@ -126,7 +126,7 @@ bool CMachineTypeMicrobee::SyncToBit(CFileReader* reader, bool verbose)
 			{
 				// Yes!
 				if (verbose)
-					printf(" rewound %i cycles to sync at %i]", 3-boundary, offs[boundary]);
+					printf(" rewound %i cycles to sync at %lli]", 3-boundary, offs[boundary]);
 				reader->Seek(offs[boundary]);
 				return true;
 			}
@@ -138,15 +138,15 @@ bool CMachineTypeMicrobee::SyncToBit(CFileReader* reader, bool verbose)
 }										 
 
 
-int CMachineTypeMicrobee::ReadBit(CFileReader* reader, bool verbose)
+int CMachineTypeMicrobee::DecodeBit(CFileReader* reader, bool verbose)
 {	
 	if (reader->GetResolution() == resBits)
 		return reader->ReadBit(verbose);
 
 	CInstrumentation* instr = reader->GetInstrumentation();
 
-	int savePos = reader->CurrentPosition();
-	int bitPos = savePos;
+	int64 savePos = reader->CurrentPosition();
+	int64 bitPos = savePos;
 
 	// This is where the "rubber meets the road" so to speak
 	//
@@ -185,11 +185,14 @@ int CMachineTypeMicrobee::ReadBit(CFileReader* reader, bool verbose)
 				break;
 		}
 	}
+
+	if (reader->_cmd->_viterbi)
+		return DecodeBitViterbi(reader, verbose, speedMultiplier);
 		
 	while (true)
 	{
 		// Remember where this cycle is, incase we need to 
-		int currentCyclePos = reader->CurrentPosition();
+		int64 currentCyclePos = reader->CurrentPosition();
 
 		// Get the next cycle
 		char cycle = reader->ReadCycleKindChecked(verbose);
@@ -217,7 +220,7 @@ int CMachineTypeMicrobee::ReadBit(CFileReader* reader, bool verbose)
 			if (reader->_cmd->_strict)
 			{
 				if (verbose)
-					printf("[strict mode leading bit error at %i - expected S or L, found '%c']", savePos, cycle);
+					printf("[strict mode leading bit error at %lli - expected S or L, found '%c']", savePos, cycle);
 			}
 			
 			continue;
@@ -229,7 +232,7 @@ int CMachineTypeMicrobee::ReadBit(CFileReader* reader, bool verbose)
 			if (resynced)
 			{
 				if (verbose)
-					printf("[leading bit error at %i - alternating S/L cycles]", savePos);
+					printf("[leading bit error at %lli - alternating S/L cycles]", savePos);
 				return -1;
 			}
 
@@ -252,7 +255,7 @@ int CMachineTypeMicrobee::ReadBit(CFileReader* reader, bool verbose)
 		if (bitKind==0)
 		{
 			if (verbose)
-				printf("[leading bit error at %i - two consecutive ambiguous cycles]", savePos);
+				printf("[leading bit error at %lli - two consecutive ambiguous cycles]", savePos);
 			return -1;
 		}
 
@@ -265,7 +268,7 @@ int CMachineTypeMicrobee::ReadBit(CFileReader* reader, bool verbose)
 			if (cycle != bitKind)
 			{
 				if (verbose)
-					printf("[internal bit error at %i - cycle number %i should have been %c but was %c]", savePos, actualCyclesRead, bitKind, cycle);
+					printf("[internal bit error at %lli - cycle number %i should have been %c but was %c]", savePos, actualCyclesRead, bitKind, cycle);
 				return -1;
 			}
 			continue;
@@ -277,7 +280,7 @@ int CMachineTypeMicrobee::ReadBit(CFileReader* reader, bool verbose)
 			if (reader->_cmd->_strict && cycle!=bitKind)
 			{
 				if (verbose)
-					printf("[strict mode trailing bit error at %i - expected '%c', found '%c']", savePos, bitKind, cycle);
+					printf("[strict mode trailing bit error at %lli - expected '%c', found '%c']", savePos, bitKind, cycle);
 			}
 
 
@@ -298,6 +301,196 @@ int CMachineTypeMicrobee::ReadBit(CFileReader* reader, bool verbose)
 	}
 }
 
+// Cost of finding a cycle of kind "cycle" as cycle number "index" of a bit made
+// of "expected" cycles of kind "kind".  Cycles at either end of a bit are often
+// ambiguous or slipped, so they cost less than the same problem inside the bit
+static int ViterbiCycleCost(char cycle, char kind, int index, int expected)
+{
+	if (cycle==kind)
+		return 0;
+
+	bool edge = index==0 || index>=expected-1;
+	if (cycle=='?')
+		return edge ? 1 : 3;
+	if (cycle=='S' || cycle=='L')
+		return edge ? 2 : 6;
+
+	// Bad cycle (with --allowbadcycles)
+	return 3;
+}
+
+// Paths costing more than this are decoding errors
+#define VITERBI_MAX_COST	8
+
+// Decode a bit by finding the best scoring interpretation of the cycles
+// from here rather than by the rules in DecodeBit.
+//
+// Each path through the trellis is a bit value, with or without a slipped
+// leading cycle, and the path's length so far.  Paths only get more expensive
+// as cycles are read, so as soon as the cheapest path that ends a bit here is
+// no more expensive than every path still going there's no better way to
+// read it and we stop - there's never any need to rewind.  A cycle that
+// properly belonged to the next bit is just counted as a mismatch and the
+// next bit finishes a cycle short.
+int CMachineTypeMicrobee::DecodeBitViterbi(CFileReader* reader, bool verbose, int speedMultiplier)
+{
+	CInstrumentation* instr = reader->GetInstrumentation();
+	int64 savePos = reader->CurrentPosition();
+
+	// Path 0 and 1 are "0" bits, 2 and 3 "1" bits.  Odd paths skip the first
+	// cycle (a leading slip, only in non-strict 300 baud mode like DecodeBit)
+	static const char kinds[2] = { 'L', 'S' };
+	int expected[2] = { 4 / speedMultiplier, 8 / speedMultiplier };
+	bool allowSlip = speedMultiplier==1 && !reader->_cmd->_strict;
+
+	int cost[4];
+	bool alive[4];
+	for (int i=0; i<4; i++)
+	{
+		cost[i] = 0;
+		alive[i] = (i & 1)==0 || allowSlip;
+	}
+
+	int cyclesRead = 0;
+	while (true)
+	{
+		char cycle = reader->ReadCycleKindChecked(verbose);
+		if (cycle==0)
+			return -1;
+		cyclesRead++;
+
+		int bestEnd = -1;
+		int bestEndCost = 0;
+		int bestOpenCost = -1;
+		for (int i=0; i<4; i++)
+		{
+			if (!alive[i])
+				continue;
+
+			int bit = i >> 1;
+			int index = (i & 1) ? cyclesRead - 2 : cyclesRead - 1;
+			int minCycles = expected[bit] > 1 ? expected[bit] - 1 : 1;
+			int maxCycles = expected[bit] + 1;
+
+			// Skipped leading cycle?
+			if (index<0)
+			{
+				cost[i] += 2;
+				bestOpenCost = bestOpenCost<0 || cost[i] < bestOpenCost ? cost[i] : bestOpenCost;
+				continue;
+			}
+
+			cost[i] += ViterbiCycleCost(cycle, kinds[bit], index, expected[bit]);
+
+			// Could the bit end here?
+			int length = index + 1;
+			if (length >= minCycles)
+			{
+				int endCost = cost[i] + (length==expected[bit] ? 0 : 1);
+				if (bestEnd<0 || endCost < bestEndCost)
+				{
+					bestEnd = i;
+					bestEndCost = endCost;
+				}
+			}
+
+			// Could it carry on?
+			if (length < maxCycles && cost[i] <= VITERBI_MAX_COST)
+				bestOpenCost = bestOpenCost<0 || cost[i] < bestOpenCost ? cost[i] : bestOpenCost;
+			else
+				alive[i] = false;
+		}
+
+		// Nothing can do better than ending the bit here?
+		if (bestEnd>=0 && (bestOpenCost<0 || bestEndCost <= bestOpenCost))
+		{
+			if (bestEndCost > VITERBI_MAX_COST)
+				break;
+
+			int bit = bestEnd >> 1;
+			if (instr)
+				instr->AddBitEntry(speedMultiplier, bit, savePos, reader->CurrentPosition());
+			return bit;
+		}
+
+		// Every path has failed?
+		if (bestOpenCost<0)
+			break;
+	}
+
+	if (verbose)
+		printf("[bit error at %lli - no sequence of %i cycles matches a bit]", savePos, cyclesRead);
+	return -1;
+}
+
+// Bits decoded while searching for byte framing.  Each bit is only decoded once
+// no matter how many framing alignments it's tested in.
+struct SYNC_BITS
+{
+	int* _bits;
+	int64* _positions;		// where each bit starts
+	int _count;
+	int _allocated;
+	bool _error;			// couldn't decode the bit after the last one
+};
+
+// Get bit number index of the run, decoding up to it if necessary.  Returns -1
+// if the bit couldn't be decoded (the reader is left after the failed bit)
+int CMachineTypeMicrobee::GetSyncBit(CFileReader* reader, SYNC_BITS& run, int index)
+{
+	while (run._count <= index)
+	{
+		if (run._error)
+			return -1;
+
+		if (run._count == run._allocated)
+		{
+			run._allocated = run._allocated==0 ? 1024 : run._allocated * 2;
+			run._bits = (int*)realloc(run._bits, run._allocated * sizeof(int));
+			run._positions = (int64*)realloc(run._positions, run._allocated * sizeof(int64));
+		}
+
+		int64 pos = reader->CurrentPosition();
+		int bit = ReadBit(reader, false);
+		if (bit<0)
+		{
+			run._error = true;
+			return -1;
+		}
+
+		run._bits[run._count] = bit;
+		run._positions[run._count] = pos;
+		run._count++;
+	}
+
+	return run._bits[index];
+}
+
+// Get the byte framed by the 11 bits starting at bit number index of the run: 
+// 0nnnnnnnn11 (little endian order).  Returns -1 if the bits don't frame a byte.
+int CMachineTypeMicrobee::GetSyncByte(CFileReader* reader, SYNC_BITS& run, int index)
+{
+	if (GetSyncBit(reader, run, index)!=0)
+		return -1;
+
+	int byte = 0;
+	for (int i=1; i<9; i++)
+	{
+		int bit = GetSyncBit(reader, run, index + i);
+		if (bit<0)
+			return -1;
+		byte = (byte >> 1) | (bit ? 0x80 : 0);
+	}
+
+	if (GetSyncBit(reader, run, index + 9)!=1 || GetSyncBit(reader, run, index + 10)!=1)
+		return -1;
+
+	return byte;
+}
+
+// Find byte framing by testing every bit alignment in turn.  The bit stream is
+// decoded once into a buffer and each alignment tested against it, rather than
+// rewinding and re-decoding the same cycles for each attempt.
 bool CMachineTypeMicrobee::SyncToByte(CFileReader* reader, bool verbose)
 {	
 	CSyncBlock sync(reader->GetInstrumentation());
@@ -311,17 +504,18 @@ bool CMachineTypeMicrobee::SyncToByte(CFileReader* reader, bool verbose)
 	if (verbose)
 		printf(" ");
 
+	SYNC_BITS run;
+	memset(&run, 0, sizeof(run));
+
+	bool synced = false;
+	int syncBit = 0;
 	while (true)
 	{
-		// Remember start of this bit
-		int syncBit = reader->CurrentPosition();
-
-		// Try to read bytes
+		// Try to read bytes aligned to this bit
 		int byteSyncMask = 0;
-		while (true)
+		for (int i=syncBit; true; i+=11)
 		{
-			// Read a byte, bail if can't...
-			int byte = ReadByte(reader, false);
+			int byte = GetSyncByte(reader, run, i);
 			if (byte<0)
 				break;
 
@@ -331,18 +525,21 @@ bool CMachineTypeMicrobee::SyncToByte(CFileReader* reader, bool verbose)
 			// then we've synchronized...
 			if (byte==0 || byteSyncMask==0xFF)
 			{
-				reader->Seek(syncBit);
-				if (verbose)
-					printf(" synced at %i]", syncBit);
-				return true;
+				synced = true;
+				break;
 			}
 		}
 
-		// Rewind to start of the bit
-		reader->Seek(syncBit);
+		if (synced)
+		{
+			reader->Seek(run._positions[syncBit]);
+			if (verbose)
+				printf(" synced at %lli]", run._positions[syncBit]);
+			break;
+		}
 
 		// Skip one bit
-		int skipBit = ReadBit(reader, false);
+		int skipBit = GetSyncBit(reader, run, syncBit);
 		if (skipBit<0)
 		{
 			// Failed to read a bit, need to resync...
@@ -350,32 +547,45 @@ bool CMachineTypeMicrobee::SyncToByte(CFileReader* reader, bool verbose)
 			{
 				if (verbose)
 					printf(":no bit sync]");
-				return false;
+				break;
 			}
 			if (verbose)
 				printf(" ");
+
+			// Start a new run
+			run._count = 0;
+			run._error = false;
+			syncBit = 0;
+			continue;
 		}
-		else
-		{
-			// Print the skipped bit
-			if (verbose)
-				printf("%i", skipBit);
-		}
 
-		if (reader->CurrentPosition()==syncBit)
+		// Print the skipped bit
+		if (verbose)
+			printf("%i", skipBit);
+		syncBit++;
+
+		// Discard bits that can no longer be used
+		if (syncBit >= 4096 && syncBit * 2 >= run._count)
 		{
-			int x=3;
+			run._count -= syncBit;
+			memmove(run._bits, run._bits + syncBit, run._count * sizeof(int));
+			memmove(run._positions, run._positions + syncBit, run._count * sizeof(int64));
+			syncBit = 0;
 		}
 	}
+
+	free(run._bits);
+	free(run._positions);
+	return synced;
 }
 
-int CMachineTypeMicrobee::ReadByte(CFileReader* reader, bool verbose)
+int CMachineTypeMicrobee::DecodeByte(CFileReader* reader, bool verbose)
 {
 	// Read 11 bits to make a byte : 0nnnnnnnn11 (little endian order)
 	int byte = 0;
 	for (int i=0; i<11; i++)
 	{
-		int offset = reader->CurrentPosition();
+		int64 offset = reader->CurrentPosition();
 		int bit = ReadBit(reader, verbose);
 		if (bit<0)
 			return -1;
@@ -385,7 +595,7 @@ int CMachineTypeMicrobee::ReadByte(CFileReader* reader, bool verbose)
 			if (bit!=0)
 			{
 				if (verbose)
-					printf("[Corrupted data at %i, byte leading bit should be 0, found %i]", offset, bit);
+					printf("[Corrupted data at %lli, byte leading bit should be 0, found %i]", offset, bit);
 				return -1;
 			}
 		}
@@ -398,7 +608,7 @@ int CMachineTypeMicrobee::ReadByte(CFileReader* reader, bool verbose)
 			if (bit!=1)
 			{
 				if (verbose)
-					printf("[Corrupted data at %i, trailing bit %i should be 1, found %i]", offset, i-9, bit);
+					printf("[Corrupted data at %lli, trailing bit %i should be 1, found %i]", offset, i-9, bit);
 				return -1;
 			}
 		}
@@ -588,10 +798,13 @@ int CMachineTypeMicrobee::ProcessBlocks(CCommandStd* c)
 		fwrite(header_bytes, 16, 1, c->binaryFile);
 
 	// Highspeed read?
-	if (header.speed && c->speedChangePos==0x7FFFFFFF)
+	if (header.speed && c->speedChangePos==SPEED_CHANGE_NONE)
 	{
 		c->speedChangePos = c->file->CurrentPosition();
 		c->speedChangeSpeed = header.speed == 2 ? 600 : 1200;
+
+		// Anything decoded from beyond here was decoded at the wrong speed
+		InvalidateDecodeCache();
 	}
 
 	if (c->renderFile!=NULL)
@@ -668,7 +881,7 @@ int CMachineTypeMicrobee::ProcessBlocks(CCommandStd* c)
 		int bytesRemaining = header.datalen - blockAddr;
 		int iBytesThisBlock = bytesRemaining > 256 ? 256 : bytesRemaining;
 
-		printf("\n[@%12i][data block 0x%.4x, %i bytes]\n", c->file->CurrentPosition(), blockAddr, iBytesThisBlock);
+		printf("\n[@%12lli][data block 0x%.4x, %i bytes]\n", c->file->CurrentPosition(), blockAddr, iBytesThisBlock);
 		c->ResetByteDump();
 		unsigned char checksum=iBytesThisBlock;
 
@@ -734,10 +947,7 @@ void CMachineTypeMicrobee::PrepareWaveMetrics(CCommandStd* c, CTapeReader* wf)
 	if (c->autoAnalyze)
 	{
 		WAVE_INFO info;
-
-		fprintf(stderr, "\n\nAnalysing wave data...");
-		AnalyseWave(wf->GetWaveReader(), c->_cycleDetector.GetMode(), 0, 0, info);
-		fprintf(stderr, "\n\n");
+		c->AnalyseInputWave(wf, info);
 
 		wf->SetCycleLengths(info.medianShortCycleLength, info.medianLongCycleLength);
 	}
@@ -7,6 +7,7 @@
 #include "MachineType.h"
 
 class CContext;
+struct SYNC_BITS;
 
 class CMachineTypeMicrobee : public CMachineType
 {
@@ -22,9 +23,9 @@ public:
 	virtual void PrepareWaveMetrics(CCommandStd* c, CTapeReader* wf);
 	
 	virtual bool SyncToBit(CFileReader* reader, bool verbose);
-	virtual int ReadBit(CFileReader* reader, bool verbose);
+	virtual int DecodeBit(CFileReader* reader, bool verbose);
 	virtual bool SyncToByte(CFileReader* reader, bool verbose);
-	virtual int ReadByte(CFileReader* reader, bool verbose);
+	virtual int DecodeByte(CFileReader* reader, bool verbose);
 
 	virtual void RenderCycleKind(CWaveWriter* writer, char kind);
 	virtual void RenderBit(CWaveWriter* writer, unsigned char bit);
@@ -32,7 +33,12 @@ public:
 
 	virtual int ProcessBlocks(CCommandStd* c);
 
+	int DecodeBitViterbi(CFileReader* reader, bool verbose, int speedMultiplier);
+	int GetSyncBit(CFileReader* reader, SYNC_BITS& run, int index);
+	int GetSyncByte(CFileReader* reader, SYNC_BITS& run, int index);
+
 	virtual bool CanRenderSquare() { return true; }
+	virtual bool CanDemodulate() { return true; }
 	virtual bool InitWaveWriterProfiled(CWaveWriterProfiled* w);
 
 	int _baud;
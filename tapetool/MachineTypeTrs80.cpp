@@ -160,7 +160,7 @@ bool CMachineTypeTrs80::SyncToBit(CFileReader* reader, bool verbose)
 	// Find the first long cycle
 	while (true)
 	{
-		int pos = reader->CurrentPosition();
+		int64 pos = reader->CurrentPosition();
 
 		// Read next cycle
 		char kind = reader->ReadCycleKind();
@@ -179,12 +179,12 @@ bool CMachineTypeTrs80::SyncToBit(CFileReader* reader, bool verbose)
 		if (kind!='S' && kind!='L')
 			continue;
 
-		int posContinue = reader->CurrentPosition();
+		int64 posContinue = reader->CurrentPosition();
 
 		// If it's a short cycle, it could be the data or the clock pulse, check it
 		if (kind=='S')
 		{
-			int pos2 = reader->CurrentPosition();
+			int64 pos2 = reader->CurrentPosition();
 			kind = reader->ReadCycleKind();
 			if (kind==0)
 			{
@@ -224,7 +224,7 @@ bool CMachineTypeTrs80::SyncToBit(CFileReader* reader, bool verbose)
 		{
 			// Go back to the sync pos
 			if (verbose)
-				printf(" rewound %i cycles to sync at %i]", rewindCycles, pos);
+				printf(" rewound %i cycles to sync at %lli]", rewindCycles, pos);
 			reader->Seek(pos);
 			return true;
 		}
@@ -237,9 +237,9 @@ bool CMachineTypeTrs80::SyncToBit(CFileReader* reader, bool verbose)
 }										 
 
 
-int CMachineTypeTrs80::ReadBit(CFileReader* reader, bool verbose)
+int CMachineTypeTrs80::DecodeBit(CFileReader* reader, bool verbose)
 {	
-	int savePos = reader->CurrentPosition();
+	int64 savePos = reader->CurrentPosition();
 	int kind = reader->ReadCycleKindChecked(verbose);
 
 	if (kind==0)
@@ -259,12 +259,12 @@ int CMachineTypeTrs80::ReadBit(CFileReader* reader, bool verbose)
 	if (verbose)
 	{
 		if (kind!=0)
-			printf("[bit error, unexpected cycle '%c' at %i]", kind, savePos);
+			printf("[bit error, unexpected cycle '%c' at %lli]", kind, savePos);
 		else
 		{
 			if (kind=='S')
 				return 1;
-			printf("[bit error, eof at %i]", savePos);
+			printf("[bit error, eof at %lli]", savePos);
 		}
 	}
 
@@ -296,7 +296,7 @@ bool CMachineTypeTrs80::SyncToByte(CFileReader* reader, bool verbose)
 
 		while (true)
 		{
-			int syncBit = reader->CurrentPosition();
+			int64 syncBit = reader->CurrentPosition();
 
 			while (true)
 			{
@@ -311,7 +311,7 @@ bool CMachineTypeTrs80::SyncToByte(CFileReader* reader, bool verbose)
 				{
 					if (verbose)
 					{
-						printf(":found sync byte at %i, resyncing to %i]", reader->CurrentPosition(), syncBit);
+						printf(":found sync byte at %lli, resyncing to %lli]", reader->CurrentPosition(), syncBit);
 					}
 					_syncBytePosition = syncBit;
 					reader->Seek(_syncBytePosition);
@@ -342,17 +342,17 @@ bool CMachineTypeTrs80::SyncToByte(CFileReader* reader, bool verbose)
 	return true;
 }
 
-int CMachineTypeTrs80::ReadByte(CFileReader* reader, bool verbose)
+int CMachineTypeTrs80::DecodeByte(CFileReader* reader, bool verbose)
 {
 	unsigned char byte = 0x00;
 	for (int i=0; i<8; i++)
 	{
-		int pos = reader->CurrentPosition();
+		int64 pos = reader->CurrentPosition();
 		int bit = ReadBit(reader, verbose);
 		if (bit < 0)
 		{
 			if (verbose && i>0)
-				printf("[Corrupted data at %i, error reading bit]", pos);
+				printf("[Corrupted data at %lli, error reading bit]", pos);
 			return -1;
 		}
 
@@ -369,15 +369,7 @@ void CMachineTypeTrs80::RenderPulse(CWaveWriter* writer)
 	int pulseLength = shortCycleLength / 2;
 	//int reboundLength = pulseLength * 2 / 3;
 
-	for (int i=0; i<pulseLength; i++)
-	{
-		writer->RenderSample((short)(sin(2*PI*i/pulseLength) * writer->GetAmplitude()));
-	}
-
-	for (int i=0; i<shortCycleLength - pulseLength; i++)
-	{
-		writer->RenderSample(0);
-	}
+	writer->RenderPulse(pulseLength, shortCycleLength);
 }
 
 void CMachineTypeTrs80::RenderCycleKind(CWaveWriter* writer, char kind)
@@ -385,10 +377,7 @@ void CMachineTypeTrs80::RenderCycleKind(CWaveWriter* writer, char kind)
 	RenderPulse(writer);
 	if (kind=='L')
 	{
-		for (int i=0; i<writer->SampleRate() / 1024; i++)
-		{
-			writer->RenderSample(0);
-		}
+		writer->RenderSilence(writer->SampleRate() / 1024);
 	}
 }
 
@@ -551,19 +540,19 @@ int CMachineTypeTrs80::ProcessBlocks(CCommandStd* c)
 
 	_eof = false;
 	bool data_ok = true;
-	int error_position;
+	int64 error_position;
 	while (!_eof)
 	{
 		// Reset block data buffer
 		_blockDataLen = 0;
 
 		// Save current position
-		int pos = c->file->CurrentPosition();
+		int64 pos = c->file->CurrentPosition();
 
 		if (c->showPositionInfo && data_ok)
 		{
 			if (c->showPositionInfo)
-				printf("\n[@%12i] ", pos);
+				printf("\n[@%12lli] ", pos);
 		}
 
 		bool data_was_ok = data_ok;
@@ -586,7 +575,7 @@ int CMachineTypeTrs80::ProcessBlocks(CCommandStd* c)
 
 		if (!data_was_ok && data_ok)
 		{
-			printf("[scan succeeded, next block found at %i, %s skipped]\n", pos, c->file->FormatDuration(pos-error_position));
+			printf("[scan succeeded, next block found at %lli, %s skipped]\n", pos, c->file->FormatDuration(pos-error_position));
 		}
 
 		// Dump the processed data (unless we're in resync mode)
@@ -607,7 +596,7 @@ int CMachineTypeTrs80::ProcessBlocks(CCommandStd* c)
 			if (!data_ok)
 			{
 				error_position = c->file->CurrentPosition();
-				printf("\n[scanning from %i for next valid block]\n", error_position);
+				printf("\n[scanning from %lli for next valid block]\n", error_position);
 			}
 		}
 
@@ -909,11 +898,7 @@ void CMachineTypeTrs80::PrepareWaveMetrics(CCommandStd* c, CTapeReader* wf)
 	if (c->autoAnalyze)
 	{
 		WAVE_INFO info;
-
-		fprintf(stderr, "\n\nAnalysing wave data...");	
-		
-		AnalyseWave(wf->GetWaveReader(), c->_cycleDetector.GetMode(), 0, 0, info);
-		fprintf(stderr, "\n\n");
+		c->AnalyseInputWave(wf, info);
 
 		int offsetForPulse;
 		if (abs(info.medianMinAmplitude) > abs(info.medianMaxAmplitude))
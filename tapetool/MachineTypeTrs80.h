@@ -19,9 +19,9 @@ public:
 	virtual void PrepareWaveMetrics(CCommandStd* c, CTapeReader* wf);
 
 	virtual bool SyncToBit(CFileReader* reader, bool verbose);
-	virtual int ReadBit(CFileReader* reader, bool verbose);
+	virtual int DecodeBit(CFileReader* reader, bool verbose);
 	virtual bool SyncToByte(CFileReader* reader, bool verbose);
-	virtual int ReadByte(CFileReader* reader, bool verbose);
+	virtual int DecodeByte(CFileReader* reader, bool verbose);
 
 	virtual void RenderPulse(CWaveWriter* writer);
 	virtual void RenderCycleKind(CWaveWriter* writer, char kind);
@@ -34,7 +34,7 @@ public:
 	bool ProcessSourceBlock(CCommandStd* c, bool verbose);
 	bool ProcessBasicBlock(CCommandStd* c, bool verbose);
 
-	int _syncBytePosition;
+	int64 _syncBytePosition;
 	bool _eof;
 	unsigned char _blockData[300];
 	int _blockDataLen;
@@ -0,0 +1,137 @@
+//////////////////////////////////////////////////////////////////////////
+// MappedFile.cpp - implementation of CMappedFile class
+
+#include "precomp.h"
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// CMappedFile
+
+// Constructor
+CMappedFile::CMappedFile()
+{
+	_data = NULL;
+	_length = 0;
+#ifdef _WIN32
+	_hFile = INVALID_HANDLE_VALUE;
+	_hMapping = NULL;
+#else
+	_fd = -1;
+#endif
+}
+
+// Destructor
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+// Map the file.  Returns false (silently) if the file can't be mapped, in
+// which case the caller is expected to fall back to stdio
+bool CMappedFile::Open(const char* filename)
+{
+	Close();
+
+#ifdef _WIN32
+	_hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_hFile==INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_hFile, &size) || size.QuadPart==0 || (unsigned long long)size.QuadPart > (size_t)-1)
+	{
+		Close();
+		return false;
+	}
+
+	_hMapping = CreateFileMappingA(_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_hMapping==NULL)
+	{
+		Close();
+		return false;
+	}
+
+	// Will fail for large files in a 32-bit process (not enough address space)
+	_data = (const unsigned char*)MapViewOfFile(_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (_data==NULL)
+	{
+		Close();
+		return false;
+	}
+
+	_length = size.QuadPart;
+#else
+	_fd = open(filename, O_RDONLY);
+	if (_fd<0)
+		return false;
+
+	struct stat st;
+	if (fstat(_fd, &st)!=0 || st.st_size==0 || (unsigned long long)st.st_size > (size_t)-1)
+	{
+		Close();
+		return false;
+	}
+
+	void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+	if (p==MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+	_data = (const unsigned char*)p;
+	_length = st.st_size;
+#endif
+
+	return true;
+}
+
+void CMappedFile::Close()
+{
+#ifdef _WIN32
+	if (_data!=NULL)
+		UnmapViewOfFile(_data);
+	if (_hMapping!=NULL)
+		CloseHandle(_hMapping);
+	if (_hFile!=INVALID_HANDLE_VALUE)
+		CloseHandle(_hFile);
+	_hMapping = NULL;
+	_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (_data!=NULL)
+		munmap((void*)_data, _length);
+	if (_fd>=0)
+		close(_fd);
+	_fd = -1;
+#endif
+
+	_data = NULL;
+	_length = 0;
+}
+
+bool CMappedFile::IsOpen()
+{
+	return _data!=NULL;
+}
+
+const unsigned char* CMappedFile::GetData()
+{
+	return _data;
+}
+
+int64 CMappedFile::GetLength()
+{
+	return _length;
+}
@@ -0,0 +1,32 @@
+//////////////////////////////////////////////////////////////////////////
+// MappedFile.h - declaration of CMappedFile class
+
+#ifndef __MAPPEDFILE_H
+#define __MAPPEDFILE_H
+
+// CMappedFile - read-only memory mapped view of an entire file
+class CMappedFile
+{
+public:
+			CMappedFile();
+	virtual ~CMappedFile();
+
+	bool Open(const char* filename);
+	void Close();
+	bool IsOpen();
+	const unsigned char* GetData();
+	int64 GetLength();
+
+	const unsigned char* _data;
+	int64 _length;
+
+#ifdef _WIN32
+	void* _hFile;
+	void* _hMapping;
+#else
+	int _fd;
+#endif
+};
+
+#endif	// __MAPPEDFILE_H
+
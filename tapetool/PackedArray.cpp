@@ -0,0 +1,139 @@
+//////////////////////////////////////////////////////////////////////////
+// PackedArray.cpp - implementation of CPackedArray class
+
+#include "precomp.h"
+
+#include "PackedArray.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// CPackedArray
+
+// Constructor
+CPackedArray::CPackedArray(int bitsPerEntry)
+{
+	_words = NULL;
+	Init(bitsPerEntry);
+}
+
+// Destructor
+CPackedArray::~CPackedArray()
+{
+	Clear();
+}
+
+// Remove all entries and change the entry size
+void CPackedArray::Init(int bitsPerEntry)
+{
+	assert(bitsPerEntry>=1 && bitsPerEntry<=8);
+
+	Clear();
+	_bitsPerEntry = bitsPerEntry;
+	_mask = (1ULL << bitsPerEntry) - 1;
+}
+
+void CPackedArray::Clear()
+{
+	if (_words!=NULL)
+		free(_words);
+
+	_words = NULL;
+	_allocatedWords = 0;
+	_length = 0;
+}
+
+int CPackedArray::GetBitsPerEntry()
+{
+	return _bitsPerEntry;
+}
+
+int64 CPackedArray::GetLength()
+{
+	return _length;
+}
+
+void CPackedArray::Add(int value)
+{
+	int64 bitOffset = _length * _bitsPerEntry;
+	int64 word = bitOffset >> 6;
+	int shift = (int)(bitOffset & 63);
+
+	// Grow, keeping a spare zeroed word so reads of straddling entries never
+	// go past the end
+	if (word + 2 > _allocatedWords)
+	{
+		int64 allocated = _allocatedWords==0 ? 1024 : _allocatedWords * 2;
+		_words = (unsigned long long*)realloc(_words, (size_t)allocated * sizeof(unsigned long long));
+		memset(_words + _allocatedWords, 0, (size_t)(allocated - _allocatedWords) * sizeof(unsigned long long));
+		_allocatedWords = allocated;
+	}
+
+	unsigned long long v = (unsigned long long)value & _mask;
+	_words[word] |= v << shift;
+	if (shift + _bitsPerEntry > 64)
+		_words[word+1] |= v >> (64 - shift);
+
+	_length++;
+}
+
+// Index of the lowest set bit
+static inline int LowestBit(unsigned long long v)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)v))
+		return (int)index;
+	_BitScanForward(&index, (unsigned long)(v >> 32));
+	return (int)index + 32;
+#else
+	return __builtin_ctzll(v);
+#endif
+}
+
+// Count how many entries match from the specified positions in two arrays
+// with the same entry size, comparing a word's worth of entries at a time
+int64 CPackedArray::CountMatching(CPackedArray& a, int64 aIndex, CPackedArray& b, int64 bIndex, int64 count)
+{
+	assert(a._bitsPerEntry==b._bitsPerEntry);
+	assert(aIndex + count <= a._length && bIndex + count <= b._length);
+
+	int bitsPerEntry = a._bitsPerEntry;
+	int perWord = 64 / bitsPerEntry;
+
+	int64 matched = 0;
+	while (matched < count)
+	{
+		int n = count - matched < perWord ? (int)(count - matched) : perWord;
+		unsigned long long diff = a.GetBits((aIndex + matched) * bitsPerEntry, n * bitsPerEntry) ^
+								b.GetBits((bIndex + matched) * bitsPerEntry, n * bitsPerEntry);
+		if (diff)
+			return matched + LowestBit(diff) / bitsPerEntry;
+		matched += n;
+	}
+
+	return matched;
+}
+
+// Cycle kinds in PACKED_CYCLEKINDS bits
+static const char g_packedCycleKinds[8] = { 0, 'S', 'L', '?', '<', '>', -1, 0 };
+
+int CPackedArray::PackCycleKind(char kind)
+{
+	for (int i=1; i<7; i++)
+	{
+		if (g_packedCycleKinds[i]==kind)
+			return i;
+	}
+
+	assert(kind==0);
+	return 0;
+}
+
+char CPackedArray::UnpackCycleKind(int value)
+{
+	return g_packedCycleKinds[value & 7];
+}
+
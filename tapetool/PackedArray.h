@@ -0,0 +1,62 @@
+//////////////////////////////////////////////////////////////////////////
+// PackedArray.h - declaration of CPackedArray class
+
+#ifndef __PACKEDARRAY_H
+#define __PACKEDARRAY_H
+
+// Bits per entry for packed bits and cycle kinds
+#define PACKED_BITS			1
+#define PACKED_CYCLEKINDS	3
+
+// CPackedArray - growable array of small unsigned values packed into 64-bit
+// words (an entry may straddle two words)
+class CPackedArray
+{
+public:
+			CPackedArray(int bitsPerEntry = 8);
+	virtual ~CPackedArray();
+
+	void Init(int bitsPerEntry);
+	void Clear();
+	int GetBitsPerEntry();
+	int64 GetLength();
+	void Add(int value);
+	int Get(int64 index);
+
+	static int64 CountMatching(CPackedArray& a, int64 aIndex, CPackedArray& b, int64 bIndex, int64 count);
+
+	static int PackCycleKind(char kind);
+	static char UnpackCycleKind(int value);
+
+protected:
+	// Get up to 64 bits starting at any bit offset
+	unsigned long long GetBits(int64 bitOffset, int bits);
+
+	unsigned long long*	_words;
+	int64				_allocatedWords;
+	int64				_length;
+	int					_bitsPerEntry;
+	unsigned long long	_mask;
+};
+
+// Inline as it's called for every unit read
+inline int CPackedArray::Get(int64 index)
+{
+	assert(index>=0 && index<_length);
+	return (int)GetBits(index * _bitsPerEntry, _bitsPerEntry);
+}
+
+inline unsigned long long CPackedArray::GetBits(int64 bitOffset, int bits)
+{
+	int64 word = bitOffset >> 6;
+	int shift = (int)(bitOffset & 63);
+
+	unsigned long long v = _words[word] >> shift;
+	if (shift!=0 && shift + bits > 64)
+		v |= _words[word+1] << (64 - shift);
+
+	return bits==64 ? v : v & ((1ULL << bits) - 1);
+}
+
+#endif	// __PACKEDARRAY_H
+
@@ -0,0 +1,236 @@
+//////////////////////////////////////////////////////////////////////////
+// SampleConverter.cpp - implementation of sample conversion kernels
+
+#include "precomp.h"
+
+#include "SampleConverter.h"
+
+// Pick the widest vector unit available at compile time
+#if defined(__AVX2__)
+#define CONVERT_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define CONVERT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+void InitSampleConversion(SAMPLE_CONVERSION& conv, int dcOffset, double amplify, bool square, int bytesPerSample)
+{
+	double mag = amplify < 0 ? -amplify : amplify;
+	int range = bytesPerSample == 1 ? 0x7f : 0x7fff;
+
+	conv.dcOffset = dcOffset;
+	conv.gainInt = (unsigned int)mag;
+	conv.gainFrac = (unsigned int)ceil((mag - conv.gainInt) * 4294967296.0);
+	if (conv.gainFrac==0 && mag != conv.gainInt)
+		conv.gainInt++;
+	conv.invert = amplify < 0 ? -1 : 0;
+	conv.square = square;
+	conv.squarePositive = (int)(amplify * range);
+	conv.squareNegative = (int)(-amplify * range);
+}
+
+#if defined(CONVERT_AVX2)
+
+// Apply dc offset, gain and squaring to 8 lanes of raw samples
+static inline __m256i Transform(__m256i v, const SAMPLE_CONVERSION& conv)
+{
+	v = _mm256_add_epi32(v, _mm256_set1_epi32(conv.dcOffset));
+
+	// Work on the magnitude so the shift truncates towards zero
+	__m256i sign = _mm256_srai_epi32(v, 31);
+	__m256i mag = _mm256_sub_epi32(_mm256_xor_si256(v, sign), sign);
+
+	// Integer part of the gain, plus the high half of the 32x32->64 fraction
+	// multiply on the even and odd lanes
+	__m256i frac = _mm256_set1_epi32((int)conv.gainFrac);
+	__m256i even = _mm256_srli_epi64(_mm256_mul_epu32(mag, frac), 32);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(mag, 32), frac);
+	__m256i scaled = _mm256_or_si256(even, _mm256_and_si256(odd, _mm256_set1_epi64x((long long)0xFFFFFFFF00000000ULL)));
+	scaled = _mm256_add_epi32(scaled, _mm256_mullo_epi32(mag, _mm256_set1_epi32((int)conv.gainInt)));
+
+	// Restore sign and wrap to 16-bits
+	sign = _mm256_xor_si256(sign, _mm256_set1_epi32(conv.invert));
+	scaled = _mm256_sub_epi32(_mm256_xor_si256(scaled, sign), sign);
+	scaled = _mm256_srai_epi32(_mm256_slli_epi32(scaled, 16), 16);
+
+	if (conv.square)
+	{
+		__m256i neg = _mm256_srai_epi32(scaled, 31);
+		scaled = _mm256_blendv_epi8(_mm256_set1_epi32(conv.squarePositive), _mm256_set1_epi32(conv.squareNegative), neg);
+	}
+
+	return scaled;
+}
+
+void ConvertSamples8(int* dst, const unsigned char* src, int count, const SAMPLE_CONVERSION& conv)
+{
+	int i = 0;
+	__m256i bias = _mm256_set1_epi32(128);
+	for (; i+8<=count; i+=8)
+	{
+		__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src+i)));
+		_mm256_storeu_si256((__m256i*)(dst+i), Transform(_mm256_sub_epi32(v, bias), conv));
+	}
+	for (; i<count; i++)
+		dst[i] = ConvertSample(src[i]-128, conv);
+}
+
+void ConvertSamples16(int* dst, const short* src, int count, const SAMPLE_CONVERSION& conv)
+{
+	int i = 0;
+	for (; i+8<=count; i+=8)
+	{
+		__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src+i)));
+		_mm256_storeu_si256((__m256i*)(dst+i), Transform(v, conv));
+	}
+	for (; i<count; i++)
+		dst[i] = ConvertSample(src[i], conv);
+}
+
+#elif defined(CONVERT_SSE2)
+
+// Apply dc offset, gain and squaring to 4 lanes of raw samples
+static inline __m128i Transform(__m128i v, const SAMPLE_CONVERSION& conv)
+{
+	v = _mm_add_epi32(v, _mm_set1_epi32(conv.dcOffset));
+
+	// Work on the magnitude so the shift truncates towards zero
+	__m128i sign = _mm_srai_epi32(v, 31);
+	__m128i mag = _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+
+	// Integer part of the gain, plus the high half of the 32x32->64 fraction
+	// multiply on the even and odd lanes (SSE2 has no 32-bit mullo, so the
+	// integer part goes through mul_epu32 too)
+	__m128i magOdd = _mm_srli_epi64(mag, 32);
+	__m128i hiMask = _mm_set_epi32(-1, 0, -1, 0);
+	__m128i frac = _mm_set1_epi32((int)conv.gainFrac);
+	__m128i scaled = _mm_or_si128(_mm_srli_epi64(_mm_mul_epu32(mag, frac), 32), _mm_and_si128(_mm_mul_epu32(magOdd, frac), hiMask));
+	__m128i gainInt = _mm_set1_epi32((int)conv.gainInt);
+	__m128i whole = _mm_or_si128(_mm_andnot_si128(hiMask, _mm_mul_epu32(mag, gainInt)), _mm_slli_epi64(_mm_mul_epu32(magOdd, gainInt), 32));
+	scaled = _mm_add_epi32(scaled, whole);
+
+	// Restore sign and wrap to 16-bits
+	sign = _mm_xor_si128(sign, _mm_set1_epi32(conv.invert));
+	scaled = _mm_sub_epi32(_mm_xor_si128(scaled, sign), sign);
+	scaled = _mm_srai_epi32(_mm_slli_epi32(scaled, 16), 16);
+
+	if (conv.square)
+	{
+		__m128i neg = _mm_srai_epi32(scaled, 31);
+		scaled = _mm_or_si128(_mm_and_si128(neg, _mm_set1_epi32(conv.squareNegative)),
+						_mm_andnot_si128(neg, _mm_set1_epi32(conv.squarePositive)));
+	}
+
+	return scaled;
+}
+
+void ConvertSamples8(int* dst, const unsigned char* src, int count, const SAMPLE_CONVERSION& conv)
+{
+	int i = 0;
+	__m128i zero = _mm_setzero_si128();
+	__m128i bias = _mm_set1_epi32(128);
+	for (; i+16<=count; i+=16)
+	{
+		__m128i b = _mm_loadu_si128((const __m128i*)(src+i));
+		__m128i lo = _mm_unpacklo_epi8(b, zero);
+		__m128i hi = _mm_unpackhi_epi8(b, zero);
+		_mm_storeu_si128((__m128i*)(dst+i), Transform(_mm_sub_epi32(_mm_unpacklo_epi16(lo, zero), bias), conv));
+		_mm_storeu_si128((__m128i*)(dst+i+4), Transform(_mm_sub_epi32(_mm_unpackhi_epi16(lo, zero), bias), conv));
+		_mm_storeu_si128((__m128i*)(dst+i+8), Transform(_mm_sub_epi32(_mm_unpacklo_epi16(hi, zero), bias), conv));
+		_mm_storeu_si128((__m128i*)(dst+i+12), Transform(_mm_sub_epi32(_mm_unpackhi_epi16(hi, zero), bias), conv));
+	}
+	for (; i<count; i++)
+		dst[i] = ConvertSample(src[i]-128, conv);
+}
+
+void ConvertSamples16(int* dst, const short* src, int count, const SAMPLE_CONVERSION& conv)
+{
+	int i = 0;
+	for (; i+8<=count; i+=8)
+	{
+		// Sign extend by unpacking into the high half and shifting back down
+		__m128i s = _mm_loadu_si128((const __m128i*)(src+i));
+		_mm_storeu_si128((__m128i*)(dst+i), Transform(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16), conv));
+		_mm_storeu_si128((__m128i*)(dst+i+4), Transform(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16), conv));
+	}
+	for (; i<count; i++)
+		dst[i] = ConvertSample(src[i], conv);
+}
+
+#elif defined(CONVERT_NEON)
+
+// Apply dc offset, gain and squaring to 4 lanes of raw samples
+static inline int32x4_t Transform(int32x4_t v, const SAMPLE_CONVERSION& conv)
+{
+	v = vaddq_s32(v, vdupq_n_s32(conv.dcOffset));
+
+	// Work on the magnitude so the shift truncates towards zero
+	uint32x4_t mag = vreinterpretq_u32_s32(vabsq_s32(v));
+	uint32x2_t frac = vdup_n_u32(conv.gainFrac);
+	uint64x2_t lo = vmull_u32(vget_low_u32(mag), frac);
+	uint64x2_t hi = vmull_u32(vget_high_u32(mag), frac);
+	uint32x4_t whole = vmulq_n_u32(mag, conv.gainInt);
+	int32x4_t scaled = vreinterpretq_s32_u32(vaddq_u32(whole, vcombine_u32(vshrn_n_u64(lo, 32), vshrn_n_u64(hi, 32))));
+
+	// Restore sign and wrap to 16-bits
+	int32x4_t sign = veorq_s32(vshrq_n_s32(v, 31), vdupq_n_s32(conv.invert));
+	scaled = vsubq_s32(veorq_s32(scaled, sign), sign);
+	scaled = vshrq_n_s32(vshlq_n_s32(scaled, 16), 16);
+
+	if (conv.square)
+	{
+		uint32x4_t neg = vcltq_s32(scaled, vdupq_n_s32(0));
+		scaled = vbslq_s32(neg, vdupq_n_s32(conv.squareNegative), vdupq_n_s32(conv.squarePositive));
+	}
+
+	return scaled;
+}
+
+void ConvertSamples8(int* dst, const unsigned char* src, int count, const SAMPLE_CONVERSION& conv)
+{
+	int i = 0;
+	int32x4_t bias = vdupq_n_s32(128);
+	for (; i+8<=count; i+=8)
+	{
+		uint16x8_t w = vmovl_u8(vld1_u8(src+i));
+		int32x4_t lo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(w)));
+		int32x4_t hi = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(w)));
+		vst1q_s32(dst+i, Transform(vsubq_s32(lo, bias), conv));
+		vst1q_s32(dst+i+4, Transform(vsubq_s32(hi, bias), conv));
+	}
+	for (; i<count; i++)
+		dst[i] = ConvertSample(src[i]-128, conv);
+}
+
+void ConvertSamples16(int* dst, const short* src, int count, const SAMPLE_CONVERSION& conv)
+{
+	int i = 0;
+	for (; i+8<=count; i+=8)
+	{
+		int16x8_t s = vld1q_s16(src+i);
+		vst1q_s32(dst+i, Transform(vmovl_s16(vget_low_s16(s)), conv));
+		vst1q_s32(dst+i+4, Transform(vmovl_s16(vget_high_s16(s)), conv));
+	}
+	for (; i<count; i++)
+		dst[i] = ConvertSample(src[i], conv);
+}
+
+#else
+
+void ConvertSamples8(int* dst, const unsigned char* src, int count, const SAMPLE_CONVERSION& conv)
+{
+	for (int i=0; i<count; i++)
+		dst[i] = ConvertSample(src[i]-128, conv);
+}
+
+void ConvertSamples16(int* dst, const short* src, int count, const SAMPLE_CONVERSION& conv)
+{
+	for (int i=0; i<count; i++)
+		dst[i] = ConvertSample(src[i], conv);
+}
+
+#endif
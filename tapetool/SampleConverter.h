@@ -0,0 +1,44 @@
+//////////////////////////////////////////////////////////////////////////
+// SampleConverter.h - declaration of sample conversion kernels
+
+#ifndef __SAMPLECONVERTER_H
+#define __SAMPLECONVERTER_H
+
+// Describes how raw PCM samples are translated into working sample values
+// ie: (short)((raw + dcOffset) * gain), optionally squared off
+struct SAMPLE_CONVERSION
+{
+	int dcOffset;
+	unsigned int gainInt;	// 32.32 fixed point magnitude of the gain...
+	unsigned int gainFrac;	// ...rounded up so exact products aren't truncated
+	int invert;				// -1 if the gain is negative, else 0
+	bool square;
+	int squarePositive;		// value for samples >= 0 when squaring
+	int squareNegative;		// value for samples < 0 when squaring
+};
+
+void InitSampleConversion(SAMPLE_CONVERSION& conv, int dcOffset, double amplify, bool square, int bytesPerSample);
+
+// Convert a single raw sample (already centered on zero)
+inline int ConvertSample(int raw, const SAMPLE_CONVERSION& conv)
+{
+	int v = raw + conv.dcOffset;
+
+	// Multiply by gain, truncating towards zero like a double->int cast would
+	int sign = (v>>31) ^ conv.invert;
+	unsigned int mag = (unsigned int)(v<0 ? -v : v);
+	unsigned int scaled = mag * conv.gainInt + (unsigned int)(((unsigned long long)mag * conv.gainFrac) >> 32);
+	int sample = (short)(((int)scaled ^ sign) - sign);
+
+	if (conv.square)
+		sample = sample<0 ? conv.squareNegative : conv.squarePositive;
+
+	return sample;
+}
+
+// Block conversion of 8-bit unsigned and 16-bit signed PCM
+void ConvertSamples8(int* dst, const unsigned char* src, int count, const SAMPLE_CONVERSION& conv);
+void ConvertSamples16(int* dst, const short* src, int count, const SAMPLE_CONVERSION& conv);
+
+#endif	// __SAMPLECONVERTER_H
+
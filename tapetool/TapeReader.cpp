@@ -39,9 +39,9 @@ int CTapeReader::GetSampleRate()
 	return _wave.GetSampleRate();
 }
 
-int CTapeReader::GetTotalSamples()
+int64 CTapeReader::GetTotalSamples()
 {
-	return _wave.GetTotalSamples();
+	return _wave.GetSourceTotalSamples();
 }
 
 const char* CTapeReader::GetDataFormat()
@@ -65,9 +65,10 @@ bool CTapeReader::IsWaveFile()
 	return true;
 }
 
-int CTapeReader::CurrentPosition()
+// Positions are always reported in source samples, even when decimating
+int64 CTapeReader::CurrentPosition()
 {
-	return _wave.CurrentPosition();
+	return _currentPosition * _wave.GetDecimation();
 }
 
 bool CTapeReader::Open(const char* filename, Resolution res)
@@ -75,6 +76,22 @@ bool CTapeReader::Open(const char* filename, Resolution res)
 	if (!_cmd->OpenWaveReader(_wave, filename))
 		return false;
 
+	// Analysis and the cycle index both need the whole file up front
+	if (_wave.IsStreaming())
+	{
+		if (_cmd->autoAnalyze)
+			fprintf(stderr, "Can't analyse a streamed input, using the machine's default cycle lengths (use --cyclefreq to set them)\n");
+		_cmd->autoAnalyze = false;
+		_cmd->_useCycleIndex = false;
+	}
+
+	// Decimate to the working rate?  Everything below here (analysis, cycle
+	// detection and lengths) then works at the lower rate
+	if (_cmd->_workingRate > 0 && _wave.GetSourceSampleRate() / _cmd->_workingRate >= 2)
+		_wave.SetDecimation(_wave.GetSourceSampleRate() / _cmd->_workingRate);
+
+	Seek(0);
+
  	// Open instrumentation file
 	if (_cmd->instrumentRes != resNA)
 	{
@@ -97,6 +114,35 @@ void CTapeReader::Prepare()
 	// Reset the cycle detector
 	_cmd->_cycleDetector.Reset();
 
+	// Set up the demodulator if it's to be used instead
+	_demod.Close();
+	if (_cmd->_demod)
+	{
+		if (!_cmd->machine->CanDemodulate())
+			fprintf(stderr, "--demod isn't supported for this machine type, using cycle detection\n");
+		else if (!_demod.Setup(_shortCycleLength, _longCycleLength))
+			fprintf(stderr, "--demod can't be used with these cycle lengths, using cycle detection\n");
+	}
+	_demodBufferCount = 0;
+
+	// Load or build the cycle index now that the settings are final (not
+	// needed if the demodulator's finding the cycles)
+	_cycleIndex.Close();
+	if (_cmd->_useCycleIndex && !_demod.IsOpen())
+		_cycleIndex.Open(_wave, _cmd->_cycleDetector.GetMode());
+
+	// Analysis may have moved the wave reader, pick up from wherever it is now
+	_currentPosition = _wave.CurrentPosition();
+	_currentSample = _wave.CurrentSample();
+	_sampleBufferIndex = 0;
+	_sampleBufferCount = 0;
+
+	// A freshly reset detector at the start of the file is exactly where the
+	// index was built from
+	_detectorInStep = _currentPosition==0;
+	_indexedCycle = false;
+	_samplesSinceSeek = 0;
+
 	// Show info on how wave is handled
 	printf("\n[\n");
 	printf("    smoothing period:        %i\n", _wave.GetSmoothingPeriod());
@@ -104,6 +150,10 @@ void CTapeReader::Prepare()
 	printf("    amplify:                 %.1f%%\n", _wave.GetAmplify()*100);
 	printf("    convert to square:       %s\n", _wave.GetMakeSquareWave() ? "yes" : "no");
 	printf("    cycle mode:              %s\n", CCycleDetector::ToString(_cmd->_cycleDetector.GetMode()));
+	if (_wave.GetDecimation() > 1)
+		printf("    working rate:            %iHz (1/%i of the source)\n", _wave.GetSampleRate(), _wave.GetDecimation());
+	if (_demod.IsOpen())
+		printf("    cycle kinds:             FSK demodulated (%i sample window)\n", _demod.GetWindowLength());
 	if (_avgCycleLength!=0)
 	{
 		printf("    avg cycle length:        %i (%.1fHz)\n", _avgCycleLength, (double)GetSampleRate() / _avgCycleLength);
@@ -141,65 +191,191 @@ void CTapeReader::Close()
 			char temp[1024];
 			strcpy(temp, _wave.GetFileName());
 			strcat(temp, ".profile");
-			_instrumentation->Save(temp, _wave.GetTotalSamples());
+			_instrumentation->Save(temp, _wave.GetSourceTotalSamples());
 			strcat(temp, ".txt");
-			_instrumentation->SaveText(temp, _wave.GetTotalSamples());
+			_instrumentation->SaveText(temp, _wave.GetSourceTotalSamples());
 		}
 
 		delete _instrumentation;
 	}
 
 	_wave.Close();
+	_cycleIndex.Close();
+	_demod.Close();
 
 	_avgCycleLength = 0;
 	_startOfCurrentHalfCycle = 0;
 	_instrumentation = NULL;
+	_sampleBufferIndex = 0;
+	_sampleBufferCount = 0;
+	_currentPosition = 0;
+	_currentSample = 0;
+	_detectorInStep = false;
+	_indexedCycle = false;
+	_samplesSinceSeek = 0;
+	_prevSample = 0;
+	_demodBufferStart = 0;
+	_demodBufferCount = 0;
+	_demodPosition = 0;
 }
 
-char* CTapeReader::FormatDuration(int duration)
+char* CTapeReader::FormatDuration(int64 duration)
 {
 	static char sz[512];
-	sprintf(sz, "%i samples", duration);
+	sprintf(sz, "%lli samples", duration);
 	return sz;
 }
 
-void CTapeReader::Seek(int sampleNumber)
+void CTapeReader::Seek(int64 sampleNumber)
 {
+	sampleNumber /= _wave.GetDecimation();
+
+	// The cycle detector carries its state across the seek
+	SyncFromIndex();
+
 	_wave.Seek(sampleNumber);
-	_startOfCurrentHalfCycle = _wave.CurrentPosition();
+	_currentPosition = _wave.CurrentPosition();
+	_currentSample = _wave.CurrentSample();
+	_sampleBufferIndex = 0;
+	_sampleBufferCount = 0;
+	_startOfCurrentHalfCycle = _currentPosition;
+	_detectorInStep = false;
+	_samplesSinceSeek = 0;
+}
+
+// After taking cycles from the index, reposition the wave reader and put the
+// cycle detector in the state it would have been in had it found them itself
+void CTapeReader::SyncFromIndex()
+{
+	if (!_indexedCycle)
+		return;
+
+	_indexedCycle = false;
+	_wave.Seek(_currentPosition);
+	_currentSample = _wave.CurrentSample();
+	_sampleBufferIndex = 0;
+	_sampleBufferCount = 0;
+	_cmd->_cycleDetector.SetCycleState(_currentSample);
 }
 
 bool CTapeReader::NextSample()
 {
+	// Refill the read ahead buffer
+	if (_sampleBufferIndex >= _sampleBufferCount)
+	{
+		_sampleBufferIndex = 0;
+		_sampleBufferCount = _wave.ReadSamples(_sampleBuffer, SAMPLE_BLOCK_SIZE);
+		if (_sampleBufferCount==0)
+		{
+			_currentSample = EOF_SAMPLE;
+			return false;
+		}
+	}
+
 	// Get the next sample
-	return _wave.NextSample();
+	_currentSample = _sampleBuffer[_sampleBufferIndex++];
+	_currentPosition++;
+	return true;
 }
 
 bool CTapeReader::HaveSample()
 {
-	return _wave.HaveSample();
+	return _currentSample!=EOF_SAMPLE;
 }
 
 int CTapeReader::CurrentSample()
 {
-	return _wave.CurrentSample();
+	return _currentSample;
 }
 
 
 // Read one cycle from the file and return its length in samples
 int CTapeReader::ReadCycleLen()
 {
-	while (NextSample())
+	CCycleDetector& cd = _cmd->_cycleDetector;
+	while (true)
 	{
-		if (_cmd->_cycleDetector.IsNewCycle(CurrentSample()))
+		// Take the next boundary from the index if we can
+		if (_detectorInStep && _cycleIndex.IsOpen())
 		{
-			int iCycleLen = CurrentPosition() - _startOfCurrentHalfCycle;
-			_startOfCurrentHalfCycle = CurrentPosition();
-			return iCycleLen;
+			int64 boundary;
+			if (_cycleIndex.FindNext(_currentPosition, boundary))
+			{
+				_indexedCycle = true;
+				_currentPosition = boundary;
+				int iCycleLen = (int)(_currentPosition - _startOfCurrentHalfCycle);
+				_startOfCurrentHalfCycle = _currentPosition;
+				return iCycleLen;
+			}
+		}
+
+		// Otherwise read samples, carrying on from the last indexed cycle
+		SyncFromIndex();
+
+		// Refill the read ahead buffer
+		if (_sampleBufferIndex >= _sampleBufferCount)
+		{
+			_sampleBufferIndex = 0;
+			_sampleBufferCount = _wave.ReadSamples(_sampleBuffer, SAMPLE_BLOCK_SIZE);
+			if (_sampleBufferCount==0)
+			{
+				_currentSample = EOF_SAMPLE;
+				return -1;
+			}
 		}
-	}
 
-	return -1;
+		// Let the detector scan the rest of the buffer in one go
+		if (_detectorInStep)
+		{
+			int remaining = _sampleBufferCount - _sampleBufferIndex;
+			int offset;
+			if (cd.FindCycles(_sampleBuffer + _sampleBufferIndex, remaining, &offset, 1))
+			{
+				_sampleBufferIndex += offset + 1;
+				_currentPosition += offset + 1;
+				_currentSample = _sampleBuffer[_sampleBufferIndex - 1];
+				int iCycleLen = (int)(_currentPosition - _startOfCurrentHalfCycle);
+				_startOfCurrentHalfCycle = _currentPosition;
+				return iCycleLen;
+			}
+
+			_sampleBufferIndex = _sampleBufferCount;
+			_currentPosition += remaining;
+			_currentSample = _sampleBuffer[_sampleBufferCount - 1];
+			continue;
+		}
+
+		// Otherwise a sample at a time until it's back in step
+		bool backInStep = false;
+		while (_sampleBufferIndex < _sampleBufferCount)
+		{
+			_currentSample = _sampleBuffer[_sampleBufferIndex++];
+			_currentPosition++;
+			bool newCycle = cd.IsNewCycle(_currentSample);
+
+			// After a seek the detector's state is left over from wherever we were
+			// before.  It's back in step once that no longer matters - after one
+			// sample for zero crossings, or once there's been a change in direction
+			// between two samples read since the seek for maxima/minima
+			if (!_detectorInStep)
+			{
+				_samplesSinceSeek++;
+				if (!cd.UsesDirection() || (_samplesSinceSeek>=2 && _currentSample!=_prevSample))
+					_detectorInStep = backInStep = true;
+				_prevSample = _currentSample;
+			}
+
+			if (newCycle)
+			{
+				int iCycleLen = (int)(_currentPosition - _startOfCurrentHalfCycle);
+				_startOfCurrentHalfCycle = _currentPosition;
+				return iCycleLen;
+			}
+
+			if (backInStep)
+				break;
+		}
+	}
 }
 
 char CTapeReader::ReadCycleKind()
@@ -210,7 +386,7 @@ char CTapeReader::ReadCycleKind()
 	}
 	else
 	{
-		int pos = CurrentPosition();
+		int64 pos = CurrentPosition();
 		char kind = ReadCycleKindInternal();
 		_instrumentation->AddCycleKindEntry(kind, pos, CurrentPosition());
 		return kind;
@@ -218,6 +394,9 @@ char CTapeReader::ReadCycleKind()
 }
 char CTapeReader::ReadCycleKindInternal()
 {
+	if (_demod.IsOpen())
+		return ReadCycleKindDemod();
+
 	// Remember offset of the current cycle
 	//int cycleOffset = CurrentSampleNumber();
 
@@ -246,6 +425,86 @@ char CTapeReader::ReadCycleKindInternal()
 	return iLen < _avgCycleLength ? 'S' : 'L';
 }
 
+// Read the next cycle kind from the demodulator
+char CTapeReader::ReadCycleKindDemod()
+{
+	// Seeked somewhere else since the last cycle?
+	if ((int64)_demodPosition != _currentPosition)
+		_demodPosition = (double)_currentPosition;
+
+	// Fetch enough for the longest step too (plus one for the fractional position)
+	int available;
+	int window = _demod.GetWindowLength();
+	int wanted = _demod.GetMaxStep() + 1;
+	const int* samples = GetDemodWindow(_currentPosition, wanted > window ? wanted : window, available);
+	if (available < window)
+	{
+		_currentSample = EOF_SAMPLE;
+		return 0;
+	}
+
+	double step;
+	char kind = _demod.Demodulate(samples, step);
+
+	int64 start = _currentPosition;
+	_demodPosition += step;
+	_currentPosition = (int64)_demodPosition;
+
+	// Can only step up to the end of the file
+	if (_currentPosition - start > available)
+	{
+		_currentPosition = start + available;
+		_demodPosition = (double)_currentPosition;
+	}
+
+	_currentSample = samples[_currentPosition - start - 1];
+	_lastCycleLen = (int)(_currentPosition - start);
+	_startOfCurrentHalfCycle = _currentPosition;
+
+	// Like taking a cycle from the index, the wave reader and cycle detector
+	// are left behind until they're needed (see SyncFromIndex)
+	_indexedCycle = true;
+
+	return kind;
+}
+
+// Get length samples starting at position for the demodulator.  Reads ahead a
+// buffer at a time.  Available is set to the number of samples returned, which
+// is less than length at the end of the file.
+const int* CTapeReader::GetDemodWindow(int64 position, int length, int& available)
+{
+	int64 bufferEnd = _demodBufferStart + _demodBufferCount;
+	if (position >= _demodBufferStart && position + length <= bufferEnd)
+	{
+		available = length;
+		return _demodBuffer + (position - _demodBufferStart);
+	}
+
+	// Keep whatever's still needed
+	int keep = 0;
+	if (position >= _demodBufferStart && position < bufferEnd)
+	{
+		keep = (int)(bufferEnd - position);
+		memmove(_demodBuffer, _demodBuffer + (position - _demodBufferStart), keep * sizeof(int));
+	}
+	_demodBufferStart = position;
+	_demodBufferCount = keep;
+
+	// Top up from where the buffer ends
+	if (_wave.CurrentPosition() != position + keep)
+		_wave.Seek(position + keep);
+	while (_demodBufferCount < length)
+	{
+		int n = _wave.ReadSamples(_demodBuffer + _demodBufferCount, SAMPLE_BLOCK_SIZE - _demodBufferCount);
+		if (n==0)
+			break;
+		_demodBufferCount += n;
+	}
+
+	available = _demodBufferCount < length ? _demodBufferCount : length;
+	return _demodBuffer;
+}
+
 int CTapeReader::LastCycleLen()
 {
 	return _lastCycleLen;
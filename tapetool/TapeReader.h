@@ -7,6 +7,8 @@
 #include "WaveReader.h"
 #include "FileReader.h"
 #include "CycleDetector.h"
+#include "CycleIndex.h"
+#include "FskDemodulator.h"
 
 // CWaveFileReader - reads audio data from a tape recording
 class CTapeReader : public CFileReader
@@ -18,7 +20,7 @@ public:
 	void Close();
 	int GetBytesPerSample();
 	int GetSampleRate();
-	int GetTotalSamples();
+	int64 GetTotalSamples();
 
 	bool OpenFile(const char* filename);
 
@@ -29,9 +31,9 @@ public:
 	virtual Resolution GetResolution();
 	virtual void Delete();
 	virtual bool IsWaveFile();
-	virtual int CurrentPosition();
-	virtual char* FormatDuration(int duration);
-	virtual void Seek(int sampleNumber);
+	virtual int64 CurrentPosition();
+	virtual char* FormatDuration(int64 duration);
+	virtual void Seek(int64 sampleNumber);
 	virtual int ReadCycleLen();
 	virtual char ReadCycleKind();
 	virtual int LastCycleLen();
@@ -41,11 +43,14 @@ public:
 	virtual bool SyncToByte(bool verbose);
 
 	char ReadCycleKindInternal();
+	char ReadCycleKindDemod();
+	const int* GetDemodWindow(int64 position, int length, int& available);
 	void SetShortCycleFrequency(int freq);
 	void SetCycleLengths(int shortCycleSamples, int longCycleSamples);
 	void SetCycleMode(CycleMode mode);
 	CycleMode GetCycleMode();
 
+	void SyncFromIndex();
 	bool NextSample();
 	bool HaveSample();
 	int CurrentSample();
@@ -55,10 +60,38 @@ public:
 	int _shortCycleLength;
 	int _longCycleLength;
 	int _cycleLengthAllowance;
-	int _startOfCurrentHalfCycle;
+	int64 _startOfCurrentHalfCycle;
 	int _lastCycleLen;
 	int _cycle_frequency;
 	CInstrumentation* _instrumentation;
+
+	// Samples read ahead from the wave reader.  _wave is positioned at the last
+	// buffered sample, _currentPosition is the sample we've actually consumed up to
+	int _sampleBuffer[SAMPLE_BLOCK_SIZE];
+	int _sampleBufferIndex;
+	int _sampleBufferCount;
+	int64 _currentPosition;
+	int _currentSample;
+
+	// Cycle boundaries found by a previous pass.  Boundaries are taken from the
+	// index whenever the cycle detector's state matches what it would be on a
+	// straight pass from the start of the file (ie: everywhere except briefly
+	// after a seek).  While cycles come from the index neither _wave nor the
+	// cycle detector are updated, see SyncFromIndex.
+	CCycleIndex _cycleIndex;
+	bool _detectorInStep;
+	bool _indexedCycle;
+	int _samplesSinceSeek;
+	int _prevSample;
+
+	// With --demod cycle kinds come from the FSK demodulator instead of the
+	// cycle detector.  It reads its own window of samples from _wave and steps
+	// through the file in fractional samples to stay locked to the tones.
+	CFskDemodulator _demod;
+	int _demodBuffer[SAMPLE_BLOCK_SIZE];
+	int64 _demodBufferStart;
+	int _demodBufferCount;
+	double _demodPosition;
 };
 
 #endif	// __TAPEREADER_H
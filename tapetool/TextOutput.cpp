@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////////
+// TextOutput.cpp - implementation of text dump output functions
+
+#include "precomp.h"
+
+#include "TextOutput.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+// Size of stdout's buffer when it's redirected to a file or pipe
+#define TEXT_OUTPUT_BUFFER_SIZE	(256 * 1024)
+
+char g_hexByteText[256][6];
+
+// Must outlive stdout so can't be owned by anything else
+static char g_stdoutBuffer[TEXT_OUTPUT_BUFFER_SIZE];
+
+// Build the lookup tables and give stdout a large buffer.  Left alone when
+// writing to a terminal so output still appears as it's produced.  When
+// decoding live, stdout is line buffered so results show up a line at a time
+// even when piped.
+void InitTextOutput(bool live)
+{
+	static const char hex[] = "0123456789abcdef";
+	for (int i=0; i<256; i++)
+	{
+		char* p = g_hexByteText[i];
+		p[0] = '0';
+		p[1] = 'x';
+		p[2] = hex[i >> 4];
+		p[3] = hex[i & 0x0F];
+		p[4] = ' ';
+		p[5] = '\0';
+	}
+
+	fflush(stdout);
+	if (live)
+		setvbuf(stdout, g_stdoutBuffer, _IOLBF, TEXT_OUTPUT_BUFFER_SIZE);
+	else if (!isatty(fileno(stdout)))
+		setvbuf(stdout, g_stdoutBuffer, _IOFBF, TEXT_OUTPUT_BUFFER_SIZE);
+}
+
+// printf("%*lli", width, value)
+void OutputInt(int64 value, int width)
+{
+	char sz[24];
+	char* p = sz + sizeof(sz);
+
+	unsigned long long mag = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+	do
+	{
+		*--p = (char)('0' + mag % 10);
+		mag /= 10;
+	} while (mag);
+
+	if (value < 0)
+		*--p = '-';
+
+	for (int len = (int)(sz + sizeof(sz) - p); len < width; len++)
+		putc_stdout(' ');
+
+	while (p < sz + sizeof(sz))
+		putc_stdout(*p++);
+}
+
@@ -0,0 +1,81 @@
+//////////////////////////////////////////////////////////////////////////
+// TextOutput.h - declaration of text dump output functions
+
+#ifndef __TEXTOUTPUT_H
+#define __TEXTOUTPUT_H
+
+// Fast formatting for the cycle, bit and byte dumps.  Output goes straight
+// into stdout's buffer (so it stays in order with anything else printf'd)
+// without going through printf's format parsing.
+
+#ifdef _MSC_VER
+#define putc_stdout(ch)	_putc_nolock(ch, stdout)
+#else
+#define putc_stdout(ch)	putc_unlocked(ch, stdout)
+#endif
+
+// "0x00 " through "0xff "
+extern char g_hexByteText[256][6];
+
+void InitTextOutput(bool live);
+void OutputInt(int64 value, int width);
+
+inline void OutputChar(char ch)
+{
+	putc_stdout(ch);
+}
+
+inline void OutputText(const char* psz)
+{
+	while (*psz)
+		putc_stdout(*psz++);
+}
+
+// printf("0x%.2x ", byte)
+inline void OutputHexByte(int byte)
+{
+	if ((unsigned int)byte < 256)
+	{
+		const char* p = g_hexByteText[byte];
+		putc_stdout(p[0]);
+		putc_stdout(p[1]);
+		putc_stdout(p[2]);
+		putc_stdout(p[3]);
+		putc_stdout(p[4]);
+	}
+	else
+	{
+		printf("0x%.2x ", byte);
+	}
+}
+
+// printf("%i", bit)
+inline void OutputBit(int bit)
+{
+	if ((unsigned int)bit < 10)
+		putc_stdout('0' + bit);
+	else
+		OutputInt(bit, 0);
+}
+
+// printf("#%i ", length)
+inline void OutputCycleLength(int length)
+{
+	putc_stdout('#');
+	OutputInt(length, 0);
+	putc_stdout(' ');
+}
+
+// printf("\n[@%12lli] ", position)
+inline void OutputPosition(int64 position)
+{
+	putc_stdout('\n');
+	putc_stdout('[');
+	putc_stdout('@');
+	OutputInt(position, 12);
+	putc_stdout(']');
+	putc_stdout(' ');
+}
+
+#endif	// __TEXTOUTPUT_H
+
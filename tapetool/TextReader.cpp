@@ -4,24 +4,47 @@
 #include "precomp.h"
 
 #include "TextReader.h"
+#include "MappedFile.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 CTextReader::CTextReader(CCommandStd* cmd) : CFileReader(cmd)
 {
 	_res = resBytes;
 	_dataFormat[0]='\0';
+	_segments = NULL;
 	InitBuffer();
 }
 
 CTextReader::~CTextReader()
 {
+	free(_segments);
 }
 
 void CTextReader::InitBuffer()
 {
-	_bufferSize = 1024 * 1024;
-	_buffer = (unsigned char*)malloc(_bufferSize);		// Grab 1mb for now
-	_dataLength = 0;
+	free(_segments);
+
+	_bytes.Init(8);
+	_bits.Init(PACKED_BITS);
+	_cycleKinds.Init(PACKED_CYCLEKINDS);
+
+	_segmentsAllocated = 1024;
+	_segments = (TEXT_SEGMENT*)malloc(_segmentsAllocated * sizeof(TEXT_SEGMENT));
+	_segmentCount = 0;
+	_totalLength = 0;
+
 	_currentPosition = 0;
+	_segment = 0;
+	_unit = 0;
+	_sub = 0;
 }
 
 int HexToInt(char ch)
@@ -35,280 +58,429 @@ int HexToInt(char ch)
 	return -1;
 }
 
-enum parseState
+// Character classes for the scanner
+enum charClass
 {
-	psReady,
-	psComment,
-	psLeadingZero,
-	psHexHi,
-	psHexLo,
-	psSlash,
-	psLineComment,
+	ccInvalid,
+	ccWhitespace,
+	ccComment,
+	ccSlash,
+	ccZero,
+	ccOne,
+	ccCycleKind,
 };
 
+static unsigned char g_charClass[256];
+
+static void InitCharClasses()
+{
+	if (g_charClass[(unsigned char)' ']==ccWhitespace)
+		return;
+
+	g_charClass[(unsigned char)' '] = ccWhitespace;
+	g_charClass[(unsigned char)'\t'] = ccWhitespace;
+	g_charClass[(unsigned char)'\n'] = ccWhitespace;
+	g_charClass[(unsigned char)'\r'] = ccWhitespace;
+	g_charClass[(unsigned char)'['] = ccComment;
+	g_charClass[(unsigned char)'/'] = ccSlash;
+	g_charClass[(unsigned char)'0'] = ccZero;
+	g_charClass[(unsigned char)'1'] = ccOne;
+	g_charClass[(unsigned char)'S'] = ccCycleKind;
+	g_charClass[(unsigned char)'L'] = ccCycleKind;
+	g_charClass[(unsigned char)'?'] = ccCycleKind;
+	g_charClass[(unsigned char)'<'] = ccCycleKind;
+	g_charClass[(unsigned char)'>'] = ccCycleKind;
+}
+
+// Find the first non-whitespace character at or after pos
+static int64 SkipWhitespace(const unsigned char* p, int64 pos, int64 length)
+{
+#if defined(SCAN_SSE2)
+	__m128i space = _mm_set1_epi8(' ');
+	__m128i tab = _mm_set1_epi8('\t');
+	__m128i lf = _mm_set1_epi8('\n');
+	__m128i cr = _mm_set1_epi8('\r');
+	while (pos + 16 <= length)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(p + pos));
+		__m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+						_mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+		unsigned int mask = ~(unsigned int)_mm_movemask_epi8(ws) & 0xFFFF;
+		if (mask)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return pos + index;
+#else
+			return pos + __builtin_ctz(mask);
+#endif
+		}
+		pos += 16;
+	}
+#endif
+
+	while (pos < length && g_charClass[p[pos]]==ccWhitespace)
+		pos++;
+	return pos;
+}
+
 bool CTextReader::Open(const char* filename, Resolution res)
 {
 	_res = res;
 
-	// Open the file
-    FILE* file=fopen(filename,"rt");
-	if (file==NULL)
+	// Map the file, or failing that read it all in
+	CMappedFile map;
+	const unsigned char* text;
+	int64 length;
+	unsigned char* loaded = NULL;
+	if (map.Open(filename))
+	{
+		text = map.GetData();
+		length = map.GetLength();
+	}
+	else
+	{
+		FILE* file=fopen(filename,"rb");
+		if (file==NULL)
+		{
+			fprintf(stderr, "Could not open '%s' - %s (%i)\n", filename, strerror(errno), errno);
+			return false;
+		}
+
+		fseek64(file, 0, SEEK_END);
+		length = ftell64(file);
+		fseek64(file, 0, SEEK_SET);
+		loaded = (unsigned char*)malloc((size_t)length + 1);
+		length = fread(loaded, 1, (size_t)length, file);
+		fclose(file);
+		text = loaded;
+	}
+
+	bool ok = Parse(text, length);
+
+	free(loaded);
+
+	if (ok)
+		IndexSegments();
+
+	return ok;
+}
+
+// Character position for error messages.  The text used to be read a character
+// at a time in text mode, with the character after a 0 bit looked at twice, so
+// positions count those twice and (on Windows) don't count CR's before LF's.
+int64 CTextReader::ErrorPosition(const unsigned char* text, int64 offset, int64 zeroBits)
+{
+	int64 pos = offset + zeroBits;
+#ifdef _WIN32
+	for (int64 i=0; i<offset; i++)
 	{
-	    fprintf(stderr, "Could not open '%s' - %s (%i)\n", filename, strerror(errno), errno);
-		return false;
+		if (text[i]=='\r' && text[i+1]=='\n')
+			pos--;
 	}
+#endif
+	return pos;
+}
+
+bool CTextReader::Parse(const unsigned char* text, int64 length)
+{
+	InitCharClasses();
+
+#ifdef _WIN32
+	// Text mode stops at Ctrl+Z
+	const unsigned char* eof = (const unsigned char*)memchr(text, 0x1A, (size_t)length);
+	if (eof!=NULL)
+		length = eof - text;
+#endif
 
-	// Parse the file
-	parseState state = psReady;
-	int ch;
-	int pos=-1;
-	bool ReadNextChar = true;
-	int data;
+	// Comment text (only kept to look for the format, and not reset between
+	// a // comment and the [comment] before it)
 	char buf[512];
-	int bufPos=0;
-	while ( !ReadNextChar || ((ch=fgetc(file)) >= 0) )
+	int bufPos = 0;
+	buf[0] = '\0';
+
+	int64 zeroBits = 0;
+	int64 i = 0;
+	while (true)
 	{
-		ReadNextChar = true;
-		pos++;
-		switch (state)
+		i = SkipWhitespace(text, i, length);
+		if (i >= length)
+			break;
+
+		int ch = text[i];
+		switch (g_charClass[ch])
 		{
-			case psReady:
-				switch (ch)
-				{
-					case '[':
-						state = psComment;
-						bufPos=0;
-						break;
-
-					case '/':
-						state = psSlash;
-						break;
-
-					case '0':
-						state = psLeadingZero;
-						break;
-
-					case '1':
-						QueueBit(1);
-						break;
-
-					case 'S':
-					case 'L':
-					case '?':
-					case '<':
-					case '>':
-						QueueCycleKind(ch);
-						break;
-
-					case ' ':
-					case '\t':
-					case '\n':
-					case '\r':
-						break;
-
-					default:
-						fprintf(stderr, "Error parsing input text file, unexpected character '%c' at %i\n", (char)ch, pos);
-						fclose(file);
-						return false;
-				}
+			case ccOne:
+				QueueBit(1);
+				i++;
 				break;
 
-			case psComment:
-				if (ch==']')
-				{
-					state = psReady;
+			case ccCycleKind:
+				QueueCycleKind(ch);
+				i++;
+				break;
 
-					// Data format comment?
-					if (strncmp(buf, "format:", 7)==0)
+			case ccZero:
+				if (i+1 < length && text[i+1]=='x')
+				{
+					// Hex byte
+					int data = 0;
+					for (int n=2; n<4; n++)
 					{
-						strcpy(_dataFormat, buf+7);
+						if (i+n >= length)
+						{
+							fprintf(stderr, "Error parsing input text file, unexpected EOF\n");
+							return false;
+						}
+
+						int nib = HexToInt(text[i+n]);
+						if (nib<0)
+						{
+							fprintf(stderr, "Error parsing input text file, syntax error in hex byte unexpected '%c' at %lli\n", (char)text[i+n], ErrorPosition(text, i+n, zeroBits));
+							return false;
+						}
+						data = (data << 4) | nib;
 					}
+					QueueByte(data);
+					i += 4;
 				}
 				else
 				{
-					if (bufPos+1 < sizeof(buf))
+					// A trailing 0 was never queued
+					if (i+1 >= length)
 					{
-						buf[bufPos++]=ch;
-						buf[bufPos]='\0';
+						fprintf(stderr, "Error parsing input text file, unexpected EOF\n");
+						return false;
 					}
-				}
 
+					QueueBit(0);
+					zeroBits++;
+					i++;
+				}
 				break;
 
-			case psSlash:
-				if (ch=='/')
-					state = psComment;
-				else
+			case ccSlash:
+				if (i+1 >= length)
 				{
-					fprintf(stderr, "Error parsing input text file, unexpected character '%c' at %i\n", (char)ch, pos);
-					fclose(file);
+					fprintf(stderr, "Error parsing input text file, unexpected EOF\n");
 					return false;
 				}
-				break;
-
-			case psLineComment:
-				if (ch=='\r' || ch=='\n')
+				if (text[i+1]!='/')
 				{
-					state = psReady;
+					fprintf(stderr, "Error parsing input text file, unexpected character '%c' at %lli\n", (char)text[i+1], ErrorPosition(text, i+1, zeroBits));
+					return false;
 				}
-				break;
+				i += 2;
+				// fall through
 
-			case psLeadingZero:
-				if (ch=='x')
+			case ccComment:
+			{
+				if (ch=='[')
 				{
-					state = psHexHi;
+					bufPos = 0;
+					i++;
 				}
-				else
-				{
-					QueueBit(0);
-					state = psReady;
-					ReadNextChar = false;
-				}
-						
-				break;
 
-			case psHexHi:
-			case psHexLo:
-				int nib = HexToInt(ch);
-				if (nib<0)
+				const unsigned char* end = (const unsigned char*)memchr(text + i, ']', (size_t)(length - i));
+				if (end==NULL)
 				{
-					fprintf(stderr, "Error parsing input text file, syntax error in hex byte unexpected '%c' at %i\n", (char)ch, pos);
-					fclose(file);
+					fprintf(stderr, "Error parsing input text file, unexpected EOF\n");
 					return false;
 				}
 
-				if (state==psHexHi)
+				// Keep as much of the comment as fits
+				int64 endPos = end - text;
+				for (; i<endPos && bufPos+1 < (int)sizeof(buf); i++)
 				{
-					data = nib << 4;
-					state = psHexLo;
+#ifdef _WIN32
+					if (text[i]=='\r' && text[i+1]=='\n')
+						continue;
+#endif
+					buf[bufPos++] = text[i];
+					buf[bufPos] = '\0';
 				}
-				else
+				i = endPos + 1;
+
+				// Data format comment?
+				if (strncmp(buf, "format:", 7)==0)
 				{
-					data |= nib;
-					QueueByte(data);
-					state = psReady;
+					strcpy(_dataFormat, buf+7);
 				}
 				break;
+			}
+
+			default:
+				fprintf(stderr, "Error parsing input text file, unexpected character '%c' at %lli\n", (char)ch, ErrorPosition(text, i, zeroBits));
+				return false;
 		}
 	}
 
-	fclose(file);
-
-	if (state != psReady)
-	{
-		fprintf(stderr, "Error parsing input text file, unexpected EOF\n");
-		return false;
-	}
-		
 	// All good
 	return true;
 }
 
-void CTextReader::QueueData(unsigned char b)
+void CTextReader::QueueData(Resolution res, unsigned char b)
 {
-	// Grow the buffer?
-	if (_dataLength + 1 > _bufferSize)
+	CPackedArray& data = res==resBytes ? _bytes : res==resBits ? _bits : _cycleKinds;
+
+	// Start a new segment?
+	if (_segmentCount==0 || _segments[_segmentCount-1]._res!=res || _segments[_segmentCount-1]._count==TEXT_SEGMENT_UNITS)
 	{
-		_bufferSize *= 2;
-		_buffer = (unsigned char*)realloc(_buffer, _bufferSize);
+		if (_segmentCount==_segmentsAllocated)
+		{
+			_segmentsAllocated *= 2;
+			_segments = (TEXT_SEGMENT*)realloc(_segments, _segmentsAllocated * sizeof(TEXT_SEGMENT));
+		}
+
+		TEXT_SEGMENT& seg = _segments[_segmentCount++];
+		seg._res = res;
+		seg._count = 0;
+		seg._dataOffset = data.GetLength();
+		seg._start = 0;
 	}
 
-	_buffer[_dataLength++]=b;
+	_segments[_segmentCount-1]._count++;
+	data.Add(b);
 }
 
+// Coarser data already queued isn't converted, it's expanded as it's read
 void CTextReader::EnsureResolution(Resolution resRequired)
 {
-	// Do we already have the required resolution?
-	if (_res <= resRequired)
-		return;
-
-	// No data is the easy case
-	if (_dataLength==0)
-	{
+	if (_res > resRequired)
 		_res = resRequired;
-		return;
-	}
+}
 
-	// Steal the current buffer
-	int oldDataLength = _dataLength;
-	unsigned char* oldBuffer = _buffer;
+void CTextReader::QueueCycleKind(char kind)
+{
+	EnsureResolution(resCycleKinds);
+	QueueData(resCycleKinds, CPackedArray::PackCycleKind(kind));
+}
 
-	// Allocate a new one
-	InitBuffer();
+void CTextReader::QueueBit(unsigned char bit)
+{
+	EnsureResolution(resBits);
+	QueueData(resBits, bit);
+}
 
-	// Switch resolution
-	Resolution oldResolution = _res;
-	_res = resRequired;
+void CTextReader::QueueByte(unsigned char byte)
+{
+	QueueData(resBytes, byte);
+}
 
-	switch (oldResolution)
+// Work out where each segment starts once the final resolution is known
+void CTextReader::IndexSegments()
+{
+	int64 pos = 0;
+	for (int i=0; i<_segmentCount; i++)
 	{
-		case resBytes:
-			for (int i=0; i<oldDataLength; i++)
+		TEXT_SEGMENT& seg = _segments[i];
+		seg._start = pos;
+
+		if (seg._res==_res)
+		{
+			pos += seg._count;
+		}
+		else
+		{
+			for (int j=0; j<seg._count; j++)
 			{
-				QueueByte(oldBuffer[i]);
+				int length;
+				ExpandUnit(seg._res, GetUnit(seg, j), 0, length);
+				pos += length;
 			}
-			break;
+		}
+	}
+
+	_totalLength = pos;
+	Seek(0);
+}
+
+// Get a unit at its own resolution
+int CTextReader::GetUnit(TEXT_SEGMENT& seg, int unit)
+{
+	switch (seg._res)
+	{
+		case resBytes:
+			return _bytes.Get(seg._dataOffset + unit);
 
 		case resBits:
-			for (int i=0; i<oldDataLength; i++)
-			{
-				QueueBit(oldBuffer[i]);
-			}
-			break;
+			return _bits.Get(seg._dataOffset + unit);
 
 		default:
-			assert(false);
+			return CPackedArray::UnpackCycleKind(_cycleKinds.Get(seg._dataOffset + unit));
 	}
-
-	// And clean up
-	free(oldBuffer);
 }
 
-void CTextReader::QueueCycleKind(char kind)
+// Bit of a byte's frame - leading 0, 8 data bits LSB first, two trailing 1's
+static int FrameBit(unsigned char byte, int index)
 {
-	EnsureResolution(resCycleKinds);
-	QueueData(kind);
+	if (index==0)
+		return 0;
+	if (index>8)
+		return 1;
+	return (byte >> (index-1)) & 1;
 }
 
-void CTextReader::QueueBit(unsigned char bit)
+// Get one unit at the reader's resolution from a unit of a coarser resolution,
+// and how many units it expands to.  Bits are 4 long or 8 short cycles.
+int CTextReader::ExpandUnit(Resolution res, unsigned char data, int index, int& length)
 {
-	if (_res < resBits)
+	if (res==_res)
 	{
-		for (int i=0; i<(bit ? 8 : 4); i++)
-		{
-			QueueCycleKind(bit ? 'S' : 'L');
-		}
+		length = 1;
+		return data;
 	}
-	else
+
+	if (_res==resBits)
 	{
-		EnsureResolution(resBits);
-		QueueData(bit);
+		length = 11;
+		return FrameBit(data, index);
 	}
+
+	if (res==resBits)
+	{
+		length = data ? 8 : 4;
+		return data ? 'S' : 'L';
+	}
+
+	// Byte to cycle kinds
+	int result = 0;
+	length = 0;
+	for (int i=0; i<11; i++)
+	{
+		int bit = FrameBit(data, i);
+		int bitLength = bit ? 8 : 4;
+		if (index >= length && index < length + bitLength)
+			result = bit ? 'S' : 'L';
+		length += bitLength;
+	}
+	return result;
 }
 
-void CTextReader::QueueByte(unsigned char byte)
+// Read the next unit at the reader's resolution, or -1 at the end
+int CTextReader::ReadUnit()
 {
-	if (_res < resBytes)
-	{
-		// Leading bit
-		QueueBit(0);
+	if (_segment >= _segmentCount)
+		return -1;
 
-		// Data bits
-		for (int i=0; i<8; i++)
-		{
-			QueueBit(byte & 0x01);
-			byte>>=1;
-		}
+	TEXT_SEGMENT& seg = _segments[_segment];
+	unsigned char data = GetUnit(seg, _unit);
+	int length;
+	int value = ExpandUnit(seg._res, data, _sub, length);
 
-		// Trailing bits
-		QueueBit(1);
-		QueueBit(1);
-	}
-	else
+	_currentPosition++;
+	if (++_sub == length)
 	{
-		EnsureResolution(resBytes);
-		QueueData(byte);
+		_sub = 0;
+		if (++_unit == seg._count)
+		{
+			_unit = 0;
+			_segment++;
+		}
 	}
+
+	return value;
 }
 
 const char* CTextReader::GetDataFormat()
@@ -331,7 +503,7 @@ bool CTextReader::IsWaveFile()
 	return false;
 }
 
-int CTextReader::CurrentPosition()
+int64 CTextReader::CurrentPosition()
 {
 	return _currentPosition;
 }
@@ -347,18 +519,60 @@ char CTextReader::ReadCycleKind()
 {
 	assert(_res >= resCycleKinds);
 
-	if (_currentPosition>=_dataLength)
-		return 0;
-
-	return ((char*)_buffer)[_currentPosition++];
+	int kind = ReadUnit();
+	return kind<0 ? 0 : (char)kind;
 }
 
-void CTextReader::Seek(int position)
+void CTextReader::Seek(int64 position)
 {
+	if (position==_currentPosition)
+		return;
+
 	_currentPosition = position;
+	_unit = 0;
+	_sub = 0;
+
+	if (position<0 || position>=_totalLength)
+	{
+		_segment = _segmentCount;
+		return;
+	}
+
+	// Find the segment
+	int lo = 0;
+	int hi = _segmentCount - 1;
+	while (lo < hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+		if (_segments[mid]._start <= position)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	_segment = lo;
+
+	// And the unit within it
+	TEXT_SEGMENT& seg = _segments[lo];
+	int64 offset = position - seg._start;
+	if (seg._res==_res)
+	{
+		_unit = (int)offset;
+		return;
+	}
+
+	while (true)
+	{
+		int length;
+		ExpandUnit(seg._res, GetUnit(seg, _unit), 0, length);
+		if (offset < length)
+			break;
+		offset -= length;
+		_unit++;
+	}
+	_sub = (int)offset;
 }
 
-char* CTextReader::FormatDuration(int duration)
+char* CTextReader::FormatDuration(int64 duration)
 {
 	static char sz[512];
 
@@ -381,7 +595,7 @@ char* CTextReader::FormatDuration(int duration)
 			assert(false);
 	}
 
-	sprintf(sz, "%i %s", duration, resName);
+	sprintf(sz, "%lli %s", duration, resName);
 	return sz;
 }
 
@@ -395,7 +609,7 @@ bool CTextReader::SyncToBit(bool verbose)
 	if (_res < resBits)
 		return __super::SyncToBit(verbose);
 	else
-		return _currentPosition < _dataLength;
+		return _currentPosition < _totalLength;
 }
 
 int CTextReader::ReadBit(bool verbose)
@@ -404,12 +618,7 @@ int CTextReader::ReadBit(bool verbose)
 		return __super::ReadBit(verbose);
 
 	if (_res == resBits)
-	{
-		if (_currentPosition < _dataLength)
-			return ((unsigned char*)_buffer)[_currentPosition++];
-		else
-			return -1;
-	}
+		return ReadUnit();
 
 	assert(false);
 	return -1;
@@ -420,7 +629,7 @@ bool CTextReader::SyncToByte(bool verbose)
 	if (_res < resBytes)
 		return __super::SyncToByte(verbose);
 	else
-		return _currentPosition < _dataLength;
+		return _currentPosition < _totalLength;
 }
 
 int CTextReader::ReadByte(bool verbose)
@@ -429,12 +638,7 @@ int CTextReader::ReadByte(bool verbose)
 		return __super::ReadByte(verbose);
 
 	if (_res == resBytes)
-	{
-		if (_currentPosition < _dataLength)
-			return ((unsigned char*)_buffer)[_currentPosition++];
-		else
-			return -1;
-	}
+		return ReadUnit();
 
 	assert(false);
 	return -1;
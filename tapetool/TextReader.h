@@ -5,6 +5,18 @@
 #define __TEXTREADER_H
 
 #include "FileReader.h"
+#include "PackedArray.h"
+
+// Maximum units in a segment (bounds the scan when seeking within one)
+#define TEXT_SEGMENT_UNITS	256
+
+struct TEXT_SEGMENT
+{
+	Resolution		_res;
+	int				_count;
+	int64			_dataOffset;
+	int64			_start;
+};
 
 // CTextReader - reads data from a previously generated text file
 class CTextReader : public CFileReader
@@ -17,28 +29,49 @@ public:
 	void InitBuffer();
 
 	Resolution _res;
-	int _currentPosition;
-	unsigned char* _buffer;
-	int _bufferSize;
-	int _dataLength;
 	char _dataFormat[64];
 
-	void QueueData(unsigned char b);
+	// Data as read from the file, each unit at its own resolution
+	CPackedArray _bytes;
+	CPackedArray _bits;
+	CPackedArray _cycleKinds;
+
+	// Runs of units of the same resolution, with their start positions at
+	// the reader's resolution
+	TEXT_SEGMENT* _segments;
+	int _segmentCount;
+	int _segmentsAllocated;
+	int64 _totalLength;
+
+	// Read position
+	int64 _currentPosition;
+	int _segment;
+	int _unit;
+	int _sub;
+
+	void QueueData(Resolution res, unsigned char b);
 	void EnsureResolution(Resolution resRequired);
 	void QueueCycleKind(char kind);
 	void QueueBit(unsigned char bit);
 	void QueueByte(unsigned char byte);
+	void IndexSegments();
+	int GetUnit(TEXT_SEGMENT& seg, int unit);
+	int ExpandUnit(Resolution res, unsigned char data, int index, int& length);
+	int ReadUnit();
+
+	bool Parse(const unsigned char* text, int64 length);
+	int64 ErrorPosition(const unsigned char* text, int64 offset, int64 zeroBits);
 
 	virtual bool Open(const char* filename, Resolution res);
 	virtual const char* GetDataFormat();
 	virtual Resolution GetResolution();
 	virtual void Delete();
 	virtual bool IsWaveFile();
-	virtual int CurrentPosition();
+	virtual int64 CurrentPosition();
 	virtual int ReadCycleLen();
 	virtual char ReadCycleKind();
-	virtual void Seek(int position);
-	virtual char* FormatDuration(int duration);
+	virtual void Seek(int64 position);
+	virtual char* FormatDuration(int64 duration);
 	virtual int LastCycleLen();
 	virtual bool SyncToBit(bool verbose);
 	virtual int ReadBit(bool verbose = true);
@@ -108,8 +108,7 @@ void CTimeSynchronizer::Complete()
 
 		if (sourceSamples == destSamples)
 		{
-			for (int i=0; i<int(sourceSamples); i++)
-				_dest->RenderSample(_samples[(int)(ptPrev->_actual+i)]);
+			_dest->RenderSamples(_samples + (int)ptPrev->_actual, int(sourceSamples));
 		}
 		else
 		{
@@ -132,10 +131,7 @@ void CTimeSynchronizer::Complete()
 			*/
 
 
-			for (int i=0; i<int(destSamples); i++)
-			{
-				_dest->RenderSample(new_samples[i]);
-			}
+			_dest->RenderSamples(new_samples, int(destSamples));
 		}
 	}
 }
@@ -6,49 +6,125 @@
 #include "WaveAnalysis.h"
 #include "TapeReader.h"
 
-struct BLOCK_DATA
-{
-	int minAmplitude;
-	int maxAmplitude;
-};
+#include <thread>
 
-int compareMinAmplitude(const void* va, const void* vb)
+// Counts of integer values in a fixed range, for finding the n'th smallest
+// value without keeping or sorting every value.  Values outside the range
+// (eg: very long silences) are rare and are just kept in a list.
+class CHistogram
 {
-	BLOCK_DATA* a = (BLOCK_DATA*)va;
-	BLOCK_DATA* b = (BLOCK_DATA*)vb;
-								 
-	return a->minAmplitude - b->minAmplitude;
-}
+public:
+	CHistogram(int base, int size)
+	{
+		_base = base;
+		_size = size;
+		_counts = (int*)malloc(sizeof(int) * size);
+		memset(_counts, 0, sizeof(int) * size);
+		_overflow = NULL;
+		_overflowCount = 0;
+		_overflowAllocated = 0;
+	}
 
-int compareMaxAmplitude(const void* va, const void* vb)
-{
-	BLOCK_DATA* a = (BLOCK_DATA*)va;
-	BLOCK_DATA* b = (BLOCK_DATA*)vb;
+	~CHistogram()
+	{
+		free(_counts);
+		free(_overflow);
+	}
 
-	return a->maxAmplitude - b->maxAmplitude;
-}
+	void Add(int value)
+	{
+		unsigned int bin = (unsigned int)(value - _base);
+		if (bin < (unsigned int)_size)
+		{
+			_counts[bin]++;
+			return;
+		}
 
-int compareInts(const void* va, const void* vb)
-{
-	return *(int*)va - *(int*)vb;
-}
+		if (_overflowCount==_overflowAllocated)
+		{
+			_overflowAllocated = _overflowAllocated==0 ? 256 : _overflowAllocated * 2;
+			_overflow = (int*)realloc(_overflow, sizeof(int) * _overflowAllocated);
+		}
+		_overflow[_overflowCount++] = value;
+	}
 
-void AnalyseWave(CWaveReader* wf, CycleMode cycleMode, int from, int samples, WAVE_INFO& info)
+	void Add(int value, int64 count)
+	{
+		unsigned int bin = (unsigned int)(value - _base);
+		if (bin < (unsigned int)_size)
+			_counts[bin] += (int)count;
+		else
+			while (count--) Add(value);
+	}
+
+	void Merge(const CHistogram& other)
+	{
+		for (int i=0; i<_size; i++)
+			_counts[i] += other._counts[i];
+		for (int i=0; i<other._overflowCount; i++)
+			Add(other._overflow[i]);
+	}
+
+	// Get the value at zero based index n as if all the values were sorted
+	int NthValue(int64 n)
+	{
+		// Overflow values below the range come first...
+		qsort(_overflow, _overflowCount, sizeof(int), compareInts);
+		int below = 0;
+		while (below < _overflowCount && _overflow[below] < _base)
+			below++;
+		if (n < below)
+			return _overflow[n];
+		n -= below;
+
+		// ... then the table...
+		for (int i=0; i<_size; i++)
+		{
+			if (n < _counts[i])
+				return _base + i;
+			n -= _counts[i];
+		}
+
+		// ... then overflow values above it
+		if (below + n < _overflowCount)
+			return _overflow[below + n];
+		return 0;
+	}
+
+	static int compareInts(const void* va, const void* vb)
+	{
+		return *(int*)va - *(int*)vb;
+	}
+
+	int _base;
+	int _size;
+	int* _counts;
+	int* _overflow;
+	int _overflowCount;
+	int _overflowAllocated;
+};
+
+// Analyse a range of a wave file in a single pass.  Amplitudes are tracked in
+// one second blocks and cycle lengths are histogrammed, the medians coming from
+// the histograms.
+void AnalyseWave(CWaveReader* wf, CycleMode cycleMode, int64 from, int64 samples, WAVE_INFO& info)
 {
 	memset(&info, 0, sizeof(info));
 
-	int savePos = wf->CurrentPosition();
+	int64 savePos = wf->CurrentPosition();
 
-	// Allocate block data structures
-	int numBlocks =  wf->GetTotalSamples() / wf->GetSampleRate();
+	// Number of one second blocks in the file
+	int numBlocks =  (int)(wf->GetTotalSamples() / wf->GetSampleRate());
 	if (wf->GetTotalSamples() % wf->GetSampleRate())
 		numBlocks++;
-	int cbBlocks = sizeof(BLOCK_DATA) * numBlocks;
-	BLOCK_DATA* blocks = (BLOCK_DATA*)malloc(cbBlocks);
-	memset(blocks, 0, cbBlocks);
 
-	int prev = 0;
-	bool first = true;
+	// Block minimums are <= 0 and maximums >= 0 (they start from 0)
+	CHistogram blockMins(-32768, 32769);
+	CHistogram blockMaxs(0, 32768);
+	CHistogram cycleLengths(0, 65536);
+	int blockCount = 0;
+	int blockMin = 0;
+	int blockMax = 0;
 
 	info.maxAmplitude = 0;
 	info.minAmplitude = 0;
@@ -56,113 +132,570 @@ void AnalyseWave(CWaveReader* wf, CycleMode cycleMode, int from, int samples, WA
 	info.totalCycles = 0;
 
 	int samplesLeftInBlock = wf->GetSampleRate();
-	BLOCK_DATA* currBlock = blocks;
 
 	wf->Seek(from);
 
-	int startPos = wf->CurrentPosition();
+	int64 startPos = wf->CurrentPosition();
 
-	int to = samples > 0 ? startPos + samples : 0;
+	int64 to = samples > 0 ? startPos + samples : 0;
 
 	CCycleDetector cd(cycleMode);
 
-	// Process all samples
-	int index = 0;
-	while (wf->HaveSample())
+	// Process all samples, a block at a time.  The first block is just the
+	// current sample (the one we seeked to)
+	int* buffer = (int*)malloc(sizeof(int) * SAMPLE_BLOCK_SIZE);
+	int* offsets = (int*)malloc(sizeof(int) * SAMPLE_BLOCK_SIZE);
+	buffer[0] = wf->CurrentSample();
+	int count = wf->HaveSample() ? 1 : 0;
+	int64 pos = startPos;
+	int64 cyclePos = startPos;
+	bool limitHit = false;
+	while (count>0 && !limitHit)
 	{
-		int sample = wf->CurrentSample();
-		if (cd.IsNewCycle(sample))
+		// Don't go past the end of the requested range
+		if (to>0 && pos + count > to)
 		{
-			info.totalCycles++;
+			count = (int)(to - pos);
+			limitHit = true;
 		}
 
+		int found = cd.FindCycles(buffer, count, offsets, count);
+		for (int i=0; i<found; i++)
+		{
+			int64 cycleEnd = pos + offsets[i];
+			cycleLengths.Add((int)(cycleEnd - cyclePos));
+			cyclePos = cycleEnd;
+		}
+		info.totalCycles += found;
 
-		if (sample<info.minAmplitude)
-			info.minAmplitude = sample;
-		if (sample>info.maxAmplitude)
-			info.maxAmplitude = sample;
+		for (int i=0; i<count; i++)
+		{
+			int sample = buffer[i];
 
-		if (sample<currBlock->minAmplitude)
-			currBlock->minAmplitude = sample;
-		if (sample>currBlock->maxAmplitude)
-			currBlock->maxAmplitude = sample;
+			if (sample<info.minAmplitude)
+				info.minAmplitude = sample;
+			if (sample>info.maxAmplitude)
+				info.maxAmplitude = sample;
 
-		samplesLeftInBlock--;
-		if (samplesLeftInBlock==0)
-		{
-			samplesLeftInBlock = wf->GetSampleRate();
-			currBlock++;
+			if (sample<blockMin)
+				blockMin = sample;
+			if (sample>blockMax)
+				blockMax = sample;
+
+			samplesLeftInBlock--;
+			if (samplesLeftInBlock==0)
+			{
+				samplesLeftInBlock = wf->GetSampleRate();
+				blockMins.Add(blockMin);
+				blockMaxs.Add(blockMax);
+				blockCount++;
+				blockMin = 0;
+				blockMax = 0;
+			}
 		}
 
-		prev = sample;
-		wf->NextSample();
-		if (to>0 && wf->CurrentPosition() >= to)
-			break;
+		pos += count;
 
-		first = false;
+		if (!limitHit)
+			count = wf->ReadSamples(buffer, SAMPLE_BLOCK_SIZE);
 	}
 
-	info.totalSamples = wf->CurrentPosition() - startPos;
+	free(buffer);
+	free(offsets);
+
+	// When we run off the end, the last sample read isn't counted
+	if (!limitHit && pos > startPos)
+		pos--;
 
-	// Work out median amplitudes
-	qsort(blocks, numBlocks, sizeof(BLOCK_DATA), compareMinAmplitude);
-	info.medianMinAmplitude = blocks[numBlocks/2].minAmplitude;
-	qsort(blocks, numBlocks, sizeof(BLOCK_DATA), compareMaxAmplitude);
-	info.medianMaxAmplitude = blocks[numBlocks/2].maxAmplitude;
+	info.totalSamples = pos - startPos;
+
+	// Work out median amplitudes.  Blocks not reached (including any partial
+	// final block) count as zero.
+	if (numBlocks > blockCount)
+	{
+		blockMins.Add(blockMin);
+		blockMaxs.Add(blockMax);
+		blockCount++;
+		blockMins.Add(0, numBlocks - blockCount);
+		blockMaxs.Add(0, numBlocks - blockCount);
+	}
+	if (numBlocks > 0)
+	{
+		info.medianMinAmplitude = blockMins.NthValue(numBlocks/2);
+		info.medianMaxAmplitude = blockMaxs.NthValue(numBlocks/2);
+	}
 
 	if (info.totalCycles!=0)
 	{
-		info.avgSamplesPerCycle = info.totalSamples / info.totalCycles;
+		info.avgSamplesPerCycle = (int)(info.totalSamples / info.totalCycles);
 		info.avgCycleFrequency = (double)wf->GetSampleRate() * info.totalCycles / info.totalSamples;
+
+		info.medianShortCycleLength = cycleLengths.NthValue(info.totalCycles/3);
+		info.medianShortCycleFrequency = (double)wf->GetSampleRate() / info.medianShortCycleLength;
+		info.medianLongCycleLength = cycleLengths.NthValue(info.totalCycles * 5/6);
+		info.medianLongCycleFrequency = (double)wf->GetSampleRate() / info.medianLongCycleLength;
 	}
-	
-	free(blocks);
 
-	if (info.totalCycles>0)
+	// Rewind
+	wf->Seek(savePos);
+}
+
+// Distribution free confidence interval for the value at fraction p through n
+// sorted values (normal approximation to the binomial on the rank)
+static void QuantileInterval(CHistogram& hist, int64 n, double p, int& low, int& high)
+{
+	double spread = 1.96 * sqrt(n * p * (1-p));
+	int64 lowRank = (int64)floor(n * p - spread);
+	int64 highRank = (int64)ceil(n * p + spread);
+	if (lowRank < 0)
+		lowRank = 0;
+	if (highRank > n-1)
+		highRank = n-1;
+
+	low = hist.NthValue(lowRank);
+	high = hist.NthValue(highRank);
+}
+
+// Estimate the wave info from one second windows taken from the middle of
+// evenly sized strata of the file, instead of reading the whole thing.
+// Returns false if the file is too short for this to be worthwhile.  The
+// estimate is marked unstable if there are too few cycles, or if the
+// confidence intervals for the cycle length medians are too wide to trust.
+bool EstimateWave(CWaveReader* wf, CycleMode cycleMode, int windows, WAVE_INFO& info, WAVE_ESTIMATE& est)
+{
+	memset(&info, 0, sizeof(info));
+	memset(&est, 0, sizeof(est));
+
+	int rate = wf->GetSampleRate();
+	int64 totalSamples = wf->GetTotalSamples();
+	int numBlocks = (int)(totalSamples / rate);
+	if (windows<1 || numBlocks < windows * 2)
+		return false;
+
+	int64 savePos = wf->CurrentPosition();
+
+	CHistogram blockMins(-32768, 32769);
+	CHistogram blockMaxs(0, 32768);
+	CHistogram cycleLengths(0, 65536);
+
+	info.sampleRate = rate;
+
+	CCycleDetector cd(cycleMode);
+	int* buffer = (int*)malloc(sizeof(int) * SAMPLE_BLOCK_SIZE);
+	int* offsets = (int*)malloc(sizeof(int) * SAMPLE_BLOCK_SIZE);
+	for (int w=0; w<windows; w++)
 	{
-		// Repeat, this time building a list of cycle times
-		// Process all samples
-		int* cycleList = (int*)malloc(sizeof(int) * info.totalCycles);
-		int crossingCount = 0;
-		int cycleCount = 0;
-		first = true;
-		wf->Seek(startPos);
-		int cyclePos = wf->CurrentPosition();
+		// Seek to the start of the window and measure cycles from the first
+		// boundary in it
+		int block = (int)(((int64)(2*w+1) * numBlocks) / (2*windows));
+		wf->Seek((int64)block * rate);
 		cd.Reset();
-		while (wf->HaveSample())
+		cd.IsNewCycle(wf->CurrentSample());
+
+		int blockMin = 0;
+		int blockMax = 0;
+		int64 pos = 0;
+		int64 cyclePos = -1;
+		int remaining = rate;
+		while (remaining > 0)
 		{
-			int sample = wf->CurrentSample();
-			if (cd.IsNewCycle(sample))
+			int count = wf->ReadSamples(buffer, remaining < SAMPLE_BLOCK_SIZE ? remaining : SAMPLE_BLOCK_SIZE);
+			if (count==0)
+				break;
+
+			int found = cd.FindCycles(buffer, count, offsets, count);
+			for (int i=0; i<found; i++)
 			{
-				crossingCount++;
+				int64 cycleEnd = pos + offsets[i];
+				if (cyclePos >= 0)
+				{
+					cycleLengths.Add((int)(cycleEnd - cyclePos));
+					est.sampledCycles++;
+				}
+				cyclePos = cycleEnd;
+			}
 
-				int cycleLen = wf->CurrentPosition() - cyclePos;
-				cycleList[cycleCount++] = cycleLen;
-				cyclePos = wf->CurrentPosition();
+			for (int i=0; i<count; i++)
+			{
+				int sample = buffer[i];
+				if (sample<blockMin)
+					blockMin = sample;
+				if (sample>blockMax)
+					blockMax = sample;
 			}
 
-			prev = sample;
-			wf->NextSample();
-			if (to>0 && wf->CurrentPosition() >= to)
-				break;
+			pos += count;
+			remaining -= count;
+		}
+
+		blockMins.Add(blockMin);
+		blockMaxs.Add(blockMax);
+		if (blockMin < info.minAmplitude)
+			info.minAmplitude = blockMin;
+		if (blockMax > info.maxAmplitude)
+			info.maxAmplitude = blockMax;
+
+		est.sampledSamples += pos;
+		est.windows++;
+	}
+
+	free(buffer);
+	free(offsets);
+
+	info.totalSamples = totalSamples;
+	info.medianMinAmplitude = blockMins.NthValue(est.windows/2);
+	info.medianMaxAmplitude = blockMaxs.NthValue(est.windows/2);
+
+	int n = est.sampledCycles;
+	if (n > 0)
+	{
+		info.totalCycles = (int)((double)n * totalSamples / est.sampledSamples);
+		info.avgSamplesPerCycle = (int)(est.sampledSamples / n);
+		info.avgCycleFrequency = (double)rate * n / est.sampledSamples;
+
+		info.medianShortCycleLength = cycleLengths.NthValue(n/3);
+		info.medianShortCycleFrequency = (double)rate / info.medianShortCycleLength;
+		info.medianLongCycleLength = cycleLengths.NthValue((int64)n * 5/6);
+		info.medianLongCycleFrequency = (double)rate / info.medianLongCycleLength;
+
+		QuantileInterval(cycleLengths, n, 1.0/3, est.shortCycleLow, est.shortCycleHigh);
+		QuantileInterval(cycleLengths, n, 5.0/6, est.longCycleLow, est.longCycleHigh);
+	}
+
+	// Stable if there's a reasonable number of cycles and each interval is
+	// within 10% (or one sample) of its median
+	int shortTolerance = info.medianShortCycleLength / 10;
+	int longTolerance = info.medianLongCycleLength / 10;
+	est.stable = n >= 100 && info.medianShortCycleLength > 0 &&
+		est.shortCycleHigh - est.shortCycleLow <= (shortTolerance > 1 ? shortTolerance : 1) &&
+		est.longCycleHigh - est.longCycleLow <= (longTolerance > 1 ? longTolerance : 1);
 
-			first = false;
+	// Rewind
+	wf->Seek(savePos);
+	return true;
+}
+
+// One thread's share of a parallel analysis
+struct ANALYSIS_CHUNK
+{
+	// Input
+	CWaveReader* wave;			// just for the file name and settings
+	CycleMode cycleMode;
+	int64 start;
+	int64 end;					// or 0 to read to end of file
+	bool first;
+
+	// Output
+	bool ok;
+	bool limitHit;				// stopped at end with more samples after it
+	int64 processed;
+	int minAmplitude;
+	int maxAmplitude;
+	CHistogram* blockMins;
+	CHistogram* blockMaxs;
+	CHistogram* cycleLengths;	// between cycles in this chunk
+	int blockCount;
+	int blockMin;				// trailing partial block
+	int blockMax;
+	int cycles;
+	int64 firstCycle;
+	int64 lastCycle;
+	int64 firstChange;			// first sample differing from the one before it
+	int changeDirection;
+	int changeSample;
+	int endDirection;
+};
+
+// Analyse one chunk.  Except for the first chunk the detector state at the
+// start of the chunk isn't known.  Seeding it with the previous sample is
+// enough for zero crossings, but maxima/minima also depend on the direction
+// coming in.  That's only resolved once the previous chunk is done, so for
+// those modes whether there's a cycle at the first change in direction is left
+// for the merge to decide (there can't be one before it).
+static int ReadChunkSamples(CWaveReader& wave, ANALYSIS_CHUNK* chunk, int64 pos, int* buffer)
+{
+	int want = SAMPLE_BLOCK_SIZE;
+	if (chunk->end!=0 && chunk->end - pos < want)
+		want = (int)(chunk->end - pos);
+	return want > 0 ? wave.ReadSamples(buffer, want) : 0;
+}
+
+static void AnalyseChunk(ANALYSIS_CHUNK* chunk)
+{
+	CWaveReader wave;
+	if (!wave.OpenFile(chunk->wave->GetFileName()))
+		return;
+	wave.SetDCOffset(chunk->wave->GetDCOffset());
+	wave.SetAmplify(chunk->wave->GetAmplify());
+	wave.SetSmoothingPeriod(chunk->wave->GetSmoothingPeriod());
+	wave.SetMakeSquareWave(chunk->wave->GetMakeSquareWave());
+
+	CCycleDetector cd(chunk->cycleMode);
+	bool deferChange = false;
+	int prevSample = 0;
+
+	int* buffer = (int*)malloc(sizeof(int) * SAMPLE_BLOCK_SIZE);
+	int* offsets = (int*)malloc(sizeof(int) * SAMPLE_BLOCK_SIZE);
+	int count;
+	if (chunk->first)
+	{
+		// Same as the serial analysis
+		wave.Seek(chunk->start);
+		buffer[0] = wave.CurrentSample();
+		count = wave.HaveSample() ? 1 : 0;
+	}
+	else
+	{
+		wave.Seek(chunk->start - 1);
+		prevSample = wave.CurrentSample();
+		cd.IsNewCycle(prevSample);
+		deferChange = cd.UsesDirection();
+		count = ReadChunkSamples(wave, chunk, chunk->start, buffer);
+	}
+
+	int rate = wave.GetSampleRate();
+	int samplesLeftInBlock = rate;
+	int64 pos = chunk->start;
+	while (count > 0)
+	{
+		// Find the first change for the merge to resolve
+		int i = 0;
+		if (chunk->firstChange < 0 && deferChange)
+		{
+			for (; i<count; i++)
+			{
+				if (buffer[i] != prevSample)
+				{
+					chunk->firstChange = pos + i;
+					chunk->changeDirection = buffer[i] > prevSample ? 1 : -1;
+					chunk->changeSample = buffer[i];
+					break;
+				}
+			}
+			prevSample = buffer[count-1];
 		}
 
-		// Sort cycles lengths
-		qsort(cycleList, cycleCount, sizeof(int), compareInts);
+		int found = cd.FindCycles(buffer, count, offsets, count);
+		for (i=0; i<found; i++)
+		{
+			int64 cycleEnd = pos + offsets[i];
+			if (deferChange && cycleEnd==chunk->firstChange)
+				continue;
+
+			if (chunk->cycles==0)
+				chunk->firstCycle = cycleEnd;
+			else
+				chunk->cycleLengths->Add((int)(cycleEnd - chunk->lastCycle));
+			chunk->lastCycle = cycleEnd;
+			chunk->cycles++;
+		}
 
-		if (cycleCount>0)
+		for (i=0; i<count; i++)
 		{
-			info.medianShortCycleLength = cycleList[cycleCount/3];
-			info.medianShortCycleFrequency = (double)wf->GetSampleRate() / info.medianShortCycleLength;
-			info.medianLongCycleLength = cycleList[cycleCount * 5/6];
-			info.medianLongCycleFrequency = (double)wf->GetSampleRate() / info.medianLongCycleLength;
+			int sample = buffer[i];
+
+			if (sample<chunk->minAmplitude)
+				chunk->minAmplitude = sample;
+			if (sample>chunk->maxAmplitude)
+				chunk->maxAmplitude = sample;
+
+			if (sample<chunk->blockMin)
+				chunk->blockMin = sample;
+			if (sample>chunk->blockMax)
+				chunk->blockMax = sample;
+
+			samplesLeftInBlock--;
+			if (samplesLeftInBlock==0)
+			{
+				samplesLeftInBlock = rate;
+				chunk->blockMins->Add(chunk->blockMin);
+				chunk->blockMaxs->Add(chunk->blockMax);
+				chunk->blockCount++;
+				chunk->blockMin = 0;
+				chunk->blockMax = 0;
+			}
 		}
 
-		free(cycleList);
+		pos += count;
+		count = ReadChunkSamples(wave, chunk, pos, buffer);
 	}
 
-	// Rewind
+	chunk->processed = pos - chunk->start;
+	chunk->endDirection = cd.GetDirection();
+	chunk->limitHit = chunk->end!=0 && pos==chunk->end && wave.ReadSamples(buffer, 1)==1;
+	chunk->ok = true;
+
+	free(buffer);
+	free(offsets);
+}
+
+// Would a maxima/minima detector report a cycle at a change to the specified
+// direction, given the direction before it?
+static bool IsTurningPoint(CycleMode mode, int direction, int sample, int prevDirection)
+{
+	if (direction==prevDirection)
+		return false;
+
+	switch (mode)
+	{
+		case cmMaxima: return direction<0;
+		case cmMinima: return direction>0;
+		case cmPositiveMaxima: return direction<0 && sample>0;
+		case cmNegativeMinima: return direction>0 && sample<0;
+		default: return false;
+	}
+}
+
+// Same as above but splits the range into chunks analysed on separate threads.
+// Chunks are whole numbers of one second blocks so only the cycles spanning
+// chunks need to be reconciled, making the results identical to the serial
+// analysis.
+void AnalyseWave(CWaveReader* wf, CycleMode cycleMode, int64 from, int64 samples, int threads, WAVE_INFO& info)
+{
+	if (threads<=0)
+		threads = (int)std::thread::hardware_concurrency();
+
+	int64 savePos = wf->CurrentPosition();
+	wf->Seek(from);
+	int64 startPos = wf->CurrentPosition();
 	wf->Seek(savePos);
-}
\ No newline at end of file
+
+	// Work out chunk size, don't bother with less than 10 seconds a chunk
+	int rate = wf->GetSampleRate();
+	int64 rangeEnd = wf->GetTotalSamples();
+	if (samples > 0 && startPos + samples < rangeEnd)
+		rangeEnd = startPos + samples;
+	int64 blocksPerChunk = ((rangeEnd - startPos) / rate + threads - 1) / (threads>0 ? threads : 1);
+	if (threads<=1 || blocksPerChunk < 10)
+	{
+		AnalyseWave(wf, cycleMode, from, samples, info);
+		return;
+	}
+	int64 chunkLength = blocksPerChunk * rate;
+	int chunkCount = (int)((rangeEnd - startPos + chunkLength - 1) / chunkLength);
+
+	memset(&info, 0, sizeof(info));
+	info.sampleRate = rate;
+
+	// Set up and run the chunks
+	ANALYSIS_CHUNK* chunks = (ANALYSIS_CHUNK*)malloc(sizeof(ANALYSIS_CHUNK) * chunkCount);
+	memset(chunks, 0, sizeof(ANALYSIS_CHUNK) * chunkCount);
+	std::thread** workers = (std::thread**)malloc(sizeof(std::thread*) * chunkCount);
+	for (int i=0; i<chunkCount; i++)
+	{
+		ANALYSIS_CHUNK* chunk = chunks + i;
+		chunk->wave = wf;
+		chunk->cycleMode = cycleMode;
+		chunk->start = startPos + i * chunkLength;
+		chunk->end = i==chunkCount-1 ? (samples > 0 ? startPos + samples : 0) : chunk->start + chunkLength;
+		chunk->first = i==0;
+		chunk->blockMins = new CHistogram(-32768, 32769);
+		chunk->blockMaxs = new CHistogram(0, 32768);
+		chunk->cycleLengths = new CHistogram(0, 65536);
+		chunk->firstChange = -1;
+		workers[i] = new std::thread(AnalyseChunk, chunk);
+	}
+
+	// Wait for them all
+	bool ok = true;
+	for (int i=0; i<chunkCount; i++)
+	{
+		workers[i]->join();
+		delete workers[i];
+		ok = ok && chunks[i].ok;
+	}
+	free(workers);
+
+	// Merge them in order
+	CHistogram blockMins(-32768, 32769);
+	CHistogram blockMaxs(0, 32768);
+	CHistogram cycleLengths(0, 65536);
+	int64 processed = 0;
+	int blockCount = 0;
+	int64 cyclePos = startPos;
+	int direction = 0;
+	for (int i=0; i<chunkCount; i++)
+	{
+		ANALYSIS_CHUNK* chunk = chunks + i;
+		processed += chunk->processed;
+
+		if (chunk->minAmplitude < info.minAmplitude)
+			info.minAmplitude = chunk->minAmplitude;
+		if (chunk->maxAmplitude > info.maxAmplitude)
+			info.maxAmplitude = chunk->maxAmplitude;
+
+		blockMins.Merge(*chunk->blockMins);
+		blockMaxs.Merge(*chunk->blockMaxs);
+		blockCount += chunk->blockCount;
+
+		// Resolve the deferred cycle at the first change
+		if (chunk->firstChange >= 0)
+		{
+			if (IsTurningPoint(cycleMode, chunk->changeDirection, chunk->changeSample, direction))
+			{
+				cycleLengths.Add((int)(chunk->firstChange - cyclePos));
+				cyclePos = chunk->firstChange;
+				info.totalCycles++;
+			}
+		}
+
+		// Join up this chunk's cycles
+		if (chunk->cycles > 0)
+		{
+			cycleLengths.Add((int)(chunk->firstCycle - cyclePos));
+			cycleLengths.Merge(*chunk->cycleLengths);
+			cyclePos = chunk->lastCycle;
+			info.totalCycles += chunk->cycles;
+		}
+
+		// Flat chunks just pass the direction through
+		if (chunk->first || chunk->firstChange >= 0)
+			direction = chunk->endDirection;
+
+		delete chunk->blockMins;
+		delete chunk->blockMaxs;
+		delete chunk->cycleLengths;
+	}
+
+	// Only the last chunk can end with a partial block
+	ANALYSIS_CHUNK* last = chunks + chunkCount - 1;
+	bool limitHit = last->limitHit;
+	int64 pos = startPos + processed;
+	if (!limitHit && pos > startPos)
+		pos--;
+	info.totalSamples = pos - startPos;
+
+	int numBlocks =  (int)(wf->GetTotalSamples() / rate);
+	if (wf->GetTotalSamples() % rate)
+		numBlocks++;
+	if (numBlocks > blockCount)
+	{
+		blockMins.Add(last->blockMin);
+		blockMaxs.Add(last->blockMax);
+		blockCount++;
+		blockMins.Add(0, numBlocks - blockCount);
+		blockMaxs.Add(0, numBlocks - blockCount);
+	}
+	if (numBlocks > 0)
+	{
+		info.medianMinAmplitude = blockMins.NthValue(numBlocks/2);
+		info.medianMaxAmplitude = blockMaxs.NthValue(numBlocks/2);
+	}
+
+	if (info.totalCycles!=0)
+	{
+		info.avgSamplesPerCycle = (int)(info.totalSamples / info.totalCycles);
+		info.avgCycleFrequency = (double)rate * info.totalCycles / info.totalSamples;
+
+		info.medianShortCycleLength = cycleLengths.NthValue(info.totalCycles/3);
+		info.medianShortCycleFrequency = (double)rate / info.medianShortCycleLength;
+		info.medianLongCycleLength = cycleLengths.NthValue(info.totalCycles * 5/6);
+		info.medianLongCycleFrequency = (double)rate / info.medianLongCycleLength;
+	}
+
+	free(chunks);
+
+	// Shouldn't happen, but if a thread couldn't open the file do it the slow way
+	if (!ok)
+		AnalyseWave(wf, cycleMode, from, samples, info);
+}
@@ -9,7 +9,7 @@ enum CycleMode;
 
 struct WAVE_INFO
 {
-	int totalSamples;
+	int64 totalSamples;
 	int totalCycles;
 	int sampleRate;
 	int minAmplitude;
@@ -24,8 +24,24 @@ struct WAVE_INFO
 	double medianLongCycleFrequency;
 };
 
+// Details of an estimate made by EstimateWave.  The cycle length intervals
+// are 95% confidence intervals for the medians.
+struct WAVE_ESTIMATE
+{
+	int windows;
+	int64 sampledSamples;
+	int sampledCycles;
+	int shortCycleLow;
+	int shortCycleHigh;
+	int longCycleLow;
+	int longCycleHigh;
+	bool stable;
+};
+
 
-void AnalyseWave(CWaveReader* wf, CycleMode cycleMode, int from, int samples, WAVE_INFO& info);
+void AnalyseWave(CWaveReader* wf, CycleMode cycleMode, int64 from, int64 samples, WAVE_INFO& info);
+void AnalyseWave(CWaveReader* wf, CycleMode cycleMode, int64 from, int64 samples, int threads, WAVE_INFO& info);
+bool EstimateWave(CWaveReader* wf, CycleMode cycleMode, int windows, WAVE_INFO& info, WAVE_ESTIMATE& est);
 
 #endif	// __WAVEANALYSIS_H
 
@@ -5,6 +5,19 @@
 
 #include "WaveReader.h"
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include <sys/stat.h>
+
+// Use SSE for the decimation filter where it's available at compile time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define DECIMATE_SSE2
+#include <emmintrin.h>
+#endif
+
 //////////////////////////////////////////////////////////////////////////
 // CWaveReader
 
@@ -14,7 +27,19 @@ CWaveReader::CWaveReader()
 	_smoothingPeriod = 0;
 	_smoothingBuffer = NULL;
 	_file = NULL;
+	_data = NULL;
 	_makeSquareWave = false;
+	_prefixCheckpoints = NULL;
+	_prefixCache = NULL;
+	_streamHeader = NULL;
+	_ring = NULL;
+	_streamWindow = DEFAULT_STREAM_WINDOW;
+	_decimation = 1;
+	_decimationTaps = NULL;
+	_decimationBuffer = NULL;
+	_filterChainValid = false;
+	_filteredPosition = 0;
+	_filteredSample = 0;
 	Close();
 }
 
@@ -31,11 +56,21 @@ int CWaveReader::GetBytesPerSample()
 }
 
 int CWaveReader::GetSampleRate()
+{
+	return _sampleRate / _decimation;
+}
+
+int64 CWaveReader::GetTotalSamples()
+{
+	return (_waveEndInSamples + _decimation - 1) / _decimation;
+}
+
+int CWaveReader::GetSourceSampleRate()
 {
 	return _sampleRate;
 }
 
-int CWaveReader::GetTotalSamples()
+int64 CWaveReader::GetSourceTotalSamples()
 {
 	return _waveEndInSamples;
 }
@@ -46,87 +81,217 @@ const char* CWaveReader::GetFileName()
 	return _filename;
 }
 
-int CWaveReader::CurrentPosition()
+int64 CWaveReader::CurrentPosition()
+{
+	return _filterChain.IsEmpty() ? UnfilteredPosition() : _filteredPosition;
+}
+
+int64 CWaveReader::UnfilteredPosition()
+{
+	return _decimation>1 ? _decimatedPosition : _currentSampleNumber;
+}
+
+// Check if reading from a stream (stdin or a pipe) rather than a seekable file
+bool CWaveReader::IsStreaming()
+{
+	return _streaming;
+}
+
+// Check if a seek went back further than the stream window, in which case
+// everything read after it was treated as the end of the input
+bool CWaveReader::StreamWindowExceeded()
+{
+	return _streamWindowExceeded;
+}
+
+// Set how many seconds of a streamed input are kept for seeking backwards
+void CWaveReader::SetStreamWindow(double seconds)
 {
-	return _currentSampleNumber;
+	_streamWindow = seconds;
 }
 
+// Sony Wave64 chunk GUIDs
+static const unsigned char w64Riff[16] = { 'r','i','f','f', 0x2E,0x91,0xCF,0x11,0xA5,0xD6,0x28,0xDB,0x04,0xC1,0x00,0x00 };
+static const unsigned char w64Wave[16] = { 'w','a','v','e', 0xF3,0xAC,0xD3,0x11,0x8C,0xD1,0x00,0xC0,0x4F,0x8E,0xDB,0x8A };
+static const unsigned char w64Fmt[16]  = { 'f','m','t',' ', 0xF3,0xAC,0xD3,0x11,0x8C,0xD1,0x00,0xC0,0x4F,0x8E,0xDB,0x8A };
+static const unsigned char w64Data[16] = { 'd','a','t','a', 0xF3,0xAC,0xD3,0x11,0x8C,0xD1,0x00,0xC0,0x4F,0x8E,0xDB,0x8A };
+
 bool CWaveReader::OpenFile(const char* filename)
 {
 	// Store filename
 	_filename = filename;
 
-	// Open the file
-    _file=fopen(filename,"rb");
-	if (_file==NULL)
+	// "-" reads from stdin
+	if (strcmp(filename, "-")==0)
 	{
-	    fprintf(stderr, "Could not open '%s' - %s (%i)\n", filename, strerror(errno), errno);
-		return false;
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		_file = stdin;
+		_streaming = true;
 	}
 
-	// Check RIFF header
-	unsigned long l;
-	fread(&l, 1, sizeof(l), _file);
-	if (memcmp(&l, "RIFF", 4)!=0)
+	// Try to memory map regular files, fall back to stdio if we can't.  Anything
+	// else (eg: a named pipe) must only be opened once, as closing it again could
+	// lose data or break the pipe for the writer.
+	else if (!IsRegularFile(filename) || !_map.Open(filename))
 	{
-		fclose(_file);
-		_file=NULL;
+		// Open the file
+		_file=fopen(filename,"rb");
+		if (_file==NULL)
+		{
+			fprintf(stderr, "Could not open '%s' - %s (%i)\n", filename, strerror(errno), errno);
+			return false;
+		}
+
+		// Pipes can't seek, so have to be streamed
+		_streaming = fseek64(_file, 0, SEEK_END)!=0;
+	}
+
+	// Check RIFF, RF64 or Wave64 header
+	unsigned char id[16];
+	memset(id, 0, sizeof(id));
+	ReadHeaderBytes(0, id, sizeof(id));
+	bool w64 = memcmp(id, w64Riff, 16)==0;
+	bool rf64 = memcmp(id, "RF64", 4)==0;
+	if (!w64 && !rf64 && memcmp(id, "RIFF", 4)!=0)
+	{
+		CloseFile();
 		fprintf(stderr,"%s is not a wave file.\n",filename);
 		return false;
 	}
 
 	// Work out the file length
-	fseek(_file, 0, SEEK_END);
-	int fileLength = ftell(_file);
-	fseek(_file, 4, SEEK_SET);
+	int64 fileLength;
+	if (_map.IsOpen())
+	{
+		fileLength = _map.GetLength();
+	}
+	else if (_streaming)
+	{
+		fileLength = STREAM_UNKNOWN_SAMPLES;
+	}
+	else
+	{
+		fseek64(_file, 0, SEEK_END);
+		fileLength = ftell64(_file);
+	}
+
+	// Work out the length the header claims, and check the WAVE type
+	int64 riffLength = 0;
+	int64 ds64DataLength = -1;
+	int64 firstChunk;
+	bool isWave;
+	if (w64)
+	{
+		// Wave64 sizes are 64-bit and include the chunk header
+		ReadHeaderBytes(16, &riffLength, 8);
+		ReadHeaderBytes(24, id, 16);
+		isWave = memcmp(id, w64Wave, 16)==0;
+		firstChunk = 40;
+	}
+	else
+	{
+		unsigned int l = 0;
+		ReadHeaderBytes(4, &l, 4);
+		riffLength = (int64)l + 8;
+		ReadHeaderBytes(8, id, 4);
+		isWave = memcmp(id, "WAVE", 4)==0;
+		firstChunk = 0xC;
+
+		// RF64 has the real sizes in a ds64 chunk that must come first
+		if (rf64)
+		{
+			ReadHeaderBytes(firstChunk, id, 4);
+			if (memcmp(id, "ds64", 4)!=0)
+			{
+				CloseFile();
+				fprintf(stderr,"%s is an RF64 file with no \"ds64\" chunk.\n",filename);
+				return false;
+			}
+			ReadHeaderBytes(firstChunk+8, &riffLength, 8);
+			ReadHeaderBytes(firstChunk+16, &ds64DataLength, 8);
+			riffLength += 8;
+		}
+	}
 
 	// Compare file length to data
-	fread(&l, 1, 4, _file);
-	if (fileLength > (int)(l+8))
+	if (_streaming)
 	{
-		fclose(_file);
-		_file=NULL;
+		// Length isn't known until the end of the stream
+	}
+	else if (fileLength > riffLength)
+	{
+		CloseFile();
 		fprintf(stderr,"%s is incomplete - bytes are missing.\n",filename);
 		return false;
 	}
-	else if (fileLength<(int)(l+8))
+	else if (fileLength<riffLength)
 	{
-		fclose(_file);
-		_file=NULL;
+		CloseFile();
 		fprintf(stderr,"%s has junk bytes at the end of the file.\n",filename);
 		return false;
 	}
 
-	// Read the WAVE header
-	fread(&l, 1, 4, _file);
-	if (memcmp(&l,"WAVE",4)!=0)
+	// Check the WAVE header
+	if (!isWave)
 	{
-		fclose(_file);
-		_file=NULL;
+		CloseFile();
 		fprintf(stderr,"%s is not a wave file.\n",filename);
 		return false;
 	}
 
 	// Scan chunks
-	int chunkLength = 0;
-	for (int p=0xC; p<fileLength; p+=chunkLength+8)
+	int chunkHeaderLength = w64 ? 24 : 8;
+	int64 nextChunk;
+	for (int64 p=firstChunk; p<fileLength; p=nextChunk)
 	{
 		// Read header
-		fseek(_file, p, SEEK_SET);
-		fread(&l, 1, sizeof(l), _file);
-		fread(&chunkLength, 1, sizeof(chunkLength), _file);
+		bool isFmt, isData;
+		int64 chunkLength;
+		if (w64)
+		{
+			if (!ReadHeaderBytes(p, id, 16) || !ReadHeaderBytes(p+16, &chunkLength, 8))
+				break;
+			isFmt = memcmp(id, w64Fmt, 16)==0;
+			isData = memcmp(id, w64Data, 16)==0;
+
+			// Size includes the header, chunks are 8-byte aligned
+			nextChunk = p + ((chunkLength + 7) & ~7);
+			chunkLength -= chunkHeaderLength;
+		}
+		else
+		{
+			unsigned int l;
+			if (!ReadHeaderBytes(p, id, 4) || !ReadHeaderBytes(p+4, &l, sizeof(l)))
+				break;
+			isFmt = memcmp(id, "fmt ", 4)==0;
+			isData = memcmp(id, "data", 4)==0;
+			chunkLength = l;
+
+			// RF64 data chunk size is in ds64
+			if (isData && rf64 && l==0xFFFFFFFF)
+				chunkLength = ds64DataLength;
+
+			nextChunk = p + chunkHeaderLength + chunkLength;
+		}
+
+		// Streamed files may not have a data length
+		bool unknownLength = _streaming && isData && (chunkLength<=0 || chunkLength==0xFFFFFFFF);
+		if (chunkLength<0 && !unknownLength)
+			break;
 
 		// "FMT"?
-		if (memcmp(&l,"fmt ",4)==0)
+		if (isFmt)
 		{
 			unsigned short us[8];
-			fread(us, 1, sizeof(us), _file);
+			memset(us, 0, sizeof(us));
+			ReadHeaderBytes(p+chunkHeaderLength, us, sizeof(us));
 
 			// Check for 8 or 16 bit PCM mono
 			if (us[0]!=1 || us[1]!=1 || (us[7]!=8 && us[7]!=16))
 			{
-				fclose(_file);
-				_file=0;
+				CloseFile();
 				fprintf(stderr,"Only 8 or 16-bit mono PCM format "
 					"wave files are supported.\n"
 					"%s is %u-bit %s %s format.\n",
@@ -141,33 +306,58 @@ bool CWaveReader::OpenFile(const char* filename)
 
 			// Save required info
 			_bytesPerSample = us[7]/8;
-			_sampleRate=us[2]+(((unsigned long)(us[3]))<<16);
+			UpdateConversion();
+			_sampleRate=us[2]+(((unsigned int)(us[3]))<<16);
 
 			// Check we got a sample rate
 			if (_sampleRate==0)
 			{
-				fclose(_file);
-				_file=0;
+				CloseFile();
 				fprintf(stderr, "File has sample rate 0. This is invalid!\n");
 				return false;
 			}
 		}
 
 		// Is it the data chunk
-		else if (memcmp(&l, "data", 4)==0)
+		else if (isData)
 		{
 			if(_sampleRate==0)
 			{
 				fprintf(stderr,"No \"fmt\" chunk found.\n");
-				fclose(_file);
-				_file=0;
+				CloseFile();
 				return false;
 			}
 
-			_waveOffsetInBytes = p+8;
-			_waveEndInSamples = chunkLength / _bytesPerSample;
+			_waveOffsetInBytes = p+chunkHeaderLength;
+			_waveEndInSamples = unknownLength ? STREAM_UNKNOWN_SAMPLES : chunkLength / _bytesPerSample;
 			_dataEndInSamples = _waveEndInSamples;
 
+			// Sample data follows on directly from the header in the stream
+			if (_streaming)
+			{
+				_ringLength = (int64)(_streamWindow * _sampleRate);
+				if (_ringLength < SAMPLE_BLOCK_SIZE * 4)
+					_ringLength = SAMPLE_BLOCK_SIZE * 4;
+				_ring = (unsigned char*)malloc((size_t)(_ringLength * _bytesPerSample));
+				if (_ring==NULL)
+				{
+					CloseFile();
+					fprintf(stderr, "Not enough memory for a %g second stream window.\n", _streamWindow);
+					return false;
+				}
+			}
+
+			// Clip to what's actually in the file
+			else if (_waveOffsetInBytes + _waveEndInSamples * _bytesPerSample > fileLength)
+			{
+				_waveEndInSamples = (fileLength - _waveOffsetInBytes) / _bytesPerSample;
+				_dataEndInSamples = _waveEndInSamples;
+			}
+
+			// Expose the data chunk directly when mapped
+			if (_map.IsOpen())
+				_data = _map.GetData() + _waveOffsetInBytes;
+
 			// Seek to start
 			Seek(0);
 
@@ -176,17 +366,98 @@ bool CWaveReader::OpenFile(const char* filename)
 	}
     
 	// Unexpected EOF
-	fclose(_file);
-	_file=NULL;
+	CloseFile();
 	fprintf(stderr,"No \"data\" chunk found.\n");
 
 	return false;
 }
 
-void CWaveReader::Close()
+// Check if a file name refers to a regular file (rather than a pipe or device)
+bool CWaveReader::IsRegularFile(const char* filename)
+{
+#ifdef _MSC_VER
+	struct _stat64 st;
+	if (_stat64(filename, &st)!=0)
+		return false;
+#else
+	struct stat st;
+	if (stat(filename, &st)!=0)
+		return false;
+#endif
+
+	return (st.st_mode & S_IFMT)==S_IFREG;
+}
+
+// Read bytes from the wave file header area (from the mapping if available)
+bool CWaveReader::ReadHeaderBytes(int64 offset, void* buf, int length)
+{
+	if (_map.IsOpen())
+	{
+		if (offset<0 || offset + length > _map.GetLength())
+			return false;
+		memcpy(buf, _map.GetData() + offset, length);
+		return true;
+	}
+
+	// Streams can't go back, so keep everything read so far (headers are small)
+	if (_streaming)
+	{
+		if (offset<0 || offset + length > 0x100000)
+			return false;
+
+		int needed = (int)offset + length;
+		if (needed > _streamHeaderLength)
+		{
+			unsigned char* p = (unsigned char*)realloc(_streamHeader, needed);
+			if (p==NULL)
+				return false;
+			_streamHeader = p;
+			_streamHeaderLength += (int)fread(_streamHeader + _streamHeaderLength, 1, needed - _streamHeaderLength, _file);
+			if (needed > _streamHeaderLength)
+				return false;
+		}
+
+		memcpy(buf, _streamHeader + offset, length);
+		return true;
+	}
+
+	fseek64(_file, offset, SEEK_SET);
+	return fread(buf, 1, length, _file)==(size_t)length;
+}
+
+// Release the underlying file or mapping
+void CWaveReader::CloseFile()
 {
-	if (_file!=NULL)
+	if (_file!=NULL && _file!=stdin)
 		fclose(_file);
+	_file = NULL;
+	_map.Close();
+	_data = NULL;
+
+	free(_streamHeader);
+	free(_ring);
+	_streamHeader = NULL;
+	_streamHeaderLength = 0;
+	_ring = NULL;
+	_ringLength = 0;
+	_ringStart = 0;
+	_ringEnd = 0;
+	_streaming = false;
+	_streamEOF = false;
+	_streamWindowExceeded = false;
+
+	free(_prefixCheckpoints);
+	free(_prefixCache);
+	_prefixCheckpoints = NULL;
+	_prefixCache = NULL;
+
+	_filterChain.Clear();
+	SetDecimation(1);
+}
+
+void CWaveReader::Close()
+{
+	CloseFile();
 
 	if (_smoothingBuffer!=NULL)
 		delete[] _smoothingBuffer;
@@ -197,12 +468,14 @@ void CWaveReader::Close()
 	_dataStartInSamples = 0;
 	_dataEndInSamples = 0;
 	_currentSampleNumber = 0;
+	_rawSampleNumber = 0;
 	_sampleRate = 0;
 	_bytesPerSample = 1;
 	_currentSample = 0;
 	_filename = NULL;
 	_dc_offset = 0;
 	_amplify = 1;
+	UpdateConversion();
 }
 
 void CWaveReader::SetSmoothingPeriod(int period)
@@ -223,7 +496,17 @@ void CWaveReader::SetSmoothingPeriod(int period)
 		_smoothingBufferTotal=0;
 	}
 
-	Seek(CurrentPosition());
+	SeekSource(_currentSampleNumber);
+	if (_decimation>1)
+	{
+		_decimationBufferCount = 0;
+		SeekDecimated(_decimatedPosition);
+	}
+	if (!_filterChain.IsEmpty())
+	{
+		_filterChainValid = false;
+		SeekFiltered(_filteredPosition);
+	}
 }
 
 int CWaveReader::GetSmoothingPeriod()
@@ -234,6 +517,7 @@ int CWaveReader::GetSmoothingPeriod()
 void CWaveReader::SetMakeSquareWave(bool square)
 {
 	_makeSquareWave = square;
+	UpdateConversion();
 }
 
 bool CWaveReader::GetMakeSquareWave()
@@ -244,6 +528,7 @@ bool CWaveReader::GetMakeSquareWave()
 void CWaveReader::SetDCOffset(int offset)
 {
 	_dc_offset = offset;
+	UpdateConversion();
 }
 
 int CWaveReader::GetDCOffset()
@@ -255,6 +540,7 @@ int CWaveReader::GetDCOffset()
 void CWaveReader::SetAmplify(double amp)
 {
 	_amplify = amp;
+	UpdateConversion();
 }
 
 double CWaveReader::GetAmplify()
@@ -262,12 +548,23 @@ double CWaveReader::GetAmplify()
 	return _amplify;
 }
 
+// Recalculate the fixed point conversion parameters
+void CWaveReader::UpdateConversion()
+{
+	InitSampleConversion(_conversion, _dc_offset, _amplify, _makeSquareWave, _bytesPerSample);
+	InvalidatePrefixSums();
+	_decimationBufferCount = 0;
+	_filterChainValid = false;
+}
+
 
 
-void CWaveReader::SeekRaw(int sampleNumber)
+void CWaveReader::SeekRaw(int64 sampleNumber)
 {
-	// Seek to sample
-	fseek(_file, _waveOffsetInBytes + sampleNumber * _bytesPerSample, SEEK_SET);
+	// Seek to sample (nothing to do if mapped or streamed)
+	if (_data==NULL && !_streaming)
+		fseek64(_file, _waveOffsetInBytes + sampleNumber * _bytesPerSample, SEEK_SET);
+	_rawSampleNumber = sampleNumber;
 
 	// Setup position info
 	_currentSampleNumber = sampleNumber;
@@ -276,10 +573,58 @@ void CWaveReader::SeekRaw(int sampleNumber)
 	_currentSample=ReadRawSample();
 }
 
-void CWaveReader::Seek(int sampleNumber)
+void CWaveReader::Seek(int64 sampleNumber)
+{
+	if (_filterChain.IsEmpty())
+		SeekUnfiltered(sampleNumber);
+	else
+		SeekFiltered(sampleNumber);
+}
+
+void CWaveReader::SeekUnfiltered(int64 sampleNumber)
+{
+	if (_decimation>1)
+		SeekDecimated(sampleNumber);
+	else
+		SeekSource(sampleNumber);
+}
+
+void CWaveReader::SeekSource(int64 sampleNumber)
 {
+	// When mapped, the smoothed value at any position can be calculated directly
+	// from prefix sums so there's nothing to replay
+	if (_data!=NULL && _smoothingPeriod!=0)
+	{
+		// Seeking past the end leaves us on the last sample, at EOF
+		bool eof = sampleNumber >= _waveEndInSamples;
+		if (eof)
+			sampleNumber = _waveEndInSamples - 1;
+
+		if (sampleNumber<=0)
+		{
+			// First sample is never smoothed (or translated)
+			SeekRaw(0);
+			_smoothingBufferTotal = 0;
+		}
+		else
+		{
+			int64 windowStart = sampleNumber - _smoothingPeriod;
+			if (windowStart<0)
+				windowStart = 0;
+
+			_rawSampleNumber = sampleNumber + 1;
+			_currentSampleNumber = sampleNumber;
+			_smoothingBufferTotal = (int)(PrefixSum(sampleNumber) - PrefixSum(windowStart));
+			_currentSample = _smoothingBufferTotal / _smoothingPeriod;
+		}
+
+		if (eof)
+			_currentSample = EOF_SAMPLE;
+		return;
+	}
+
 	// Go back by size of smoothing buffer
-	int startAtSampleNumber = sampleNumber - (_smoothingPeriod+1);
+	int64 startAtSampleNumber = sampleNumber - (_smoothingPeriod+1);
 	if (startAtSampleNumber<0)
 		startAtSampleNumber = 0;
 
@@ -290,15 +635,32 @@ void CWaveReader::Seek(int sampleNumber)
 	memset(_smoothingBuffer, 0, _smoothingPeriod * sizeof(int));
 	_smoothingBufferPos=0;
 	_smoothingBufferTotal=0;
-	while (CurrentPosition()  < sampleNumber)
+	while (_currentSampleNumber < sampleNumber)
 	{
-		if (!NextSample())
+		if (!NextSourceSample())
 			break;
 	}
 
 }
 
 bool CWaveReader::NextSample()
+{
+	if (!_filterChain.IsEmpty())
+	{
+		int sample;
+		return ReadFilteredSamples(&sample, 1)==1;
+	}
+
+	if (_decimation>1)
+	{
+		int sample;
+		return ReadDecimatedSamples(&sample, 1)==1;
+	}
+
+	return NextSourceSample();
+}
+
+bool CWaveReader::NextSourceSample()
 {
 	_currentSample = ReadSample();
 
@@ -315,12 +677,17 @@ bool CWaveReader::NextSample()
 
 bool CWaveReader::HaveSample()
 {
-	return _currentSample!=EOF_SAMPLE;
+	return CurrentSample()!=EOF_SAMPLE;
 }
 
 int CWaveReader::CurrentSample()
 {
-	return _currentSample;
+	return _filterChain.IsEmpty() ? UnfilteredSample() : _filteredSample;
+}
+
+int CWaveReader::UnfilteredSample()
+{
+	return _decimation>1 ? _decimatedSample : _currentSample;
 }
 
 int CWaveReader::ReadSample()
@@ -331,12 +698,7 @@ int CWaveReader::ReadSample()
 		return sample;
 
 	// Translate it
-	sample = (short)(_amplify * (_dc_offset + sample));
-	if (_makeSquareWave)
-	{
-		int Range = _bytesPerSample == 1 ? 0x7f : 0x7fff;
-		sample = (int)((sample<0 ? -_amplify : _amplify) * Range);
-	}
+	sample = ConvertSample(sample, _conversion);
 
 	// Are we smoothing?
 	if (_smoothingPeriod==0)
@@ -344,6 +706,19 @@ int CWaveReader::ReadSample()
 		return sample;
 	}
 
+	return Smooth(sample, _rawSampleNumber - 1);
+}
+
+// Push a sample through the moving average
+int CWaveReader::Smooth(int sample, int64 sampleNumber)
+{
+	// When mapped, the file itself is the history buffer
+	if (_data!=NULL)
+	{
+		_smoothingBufferTotal += sample - ConvertedSample(sampleNumber - _smoothingPeriod);
+		return _smoothingBufferTotal / _smoothingPeriod;
+	}
+
 	// Calculate new position in circular buffer
 	_smoothingBufferPos = (_smoothingBufferPos + 1) % _smoothingPeriod;
 
@@ -358,11 +733,206 @@ int CWaveReader::ReadSample()
 	return _smoothingBufferTotal / _smoothingPeriod;
 }
 
+// Read the next `count` samples (as if by count calls to NextSample/CurrentSample)
+// Returns the number of samples read, which will be less than count at the end of the file
+int CWaveReader::ReadSamples(int* dst, int count)
+{
+	if (!_filterChain.IsEmpty())
+		return ReadFilteredSamples(dst, count);
+
+	return ReadUnfilteredSamples(dst, count);
+}
+
+int CWaveReader::ReadUnfilteredSamples(int* dst, int count)
+{
+	if (_decimation>1)
+		return ReadDecimatedSamples(dst, count);
+
+	return ReadSourceSamples(dst, count);
+}
+
+int CWaveReader::ReadSourceSamples(int* dst, int count)
+{
+	// Clamp to what's available
+	int requested = count;
+	int64 available = _waveEndInSamples - _rawSampleNumber;
+	if (count > available)
+		count = (int)available;
+	if (count < 0)
+		count = 0;
+
+	int read = 0;
+	if (_data!=NULL)
+	{
+		// Convert directly from the mapped data
+		ConvertMappedSamples(dst, _rawSampleNumber, count);
+		read = count;
+	}
+	else
+	{
+		// Read through stdio (or the stream window) a block at a time
+		unsigned char raw[SAMPLE_BLOCK_SIZE * 2];
+		while (read < count)
+		{
+			int block = count - read;
+			if (block > SAMPLE_BLOCK_SIZE)
+				block = SAMPLE_BLOCK_SIZE;
+
+			int got;
+			if (_streaming)
+				got = ReadStreamSamples(raw, _rawSampleNumber + read, block);
+			else
+				got = (int)fread(raw, _bytesPerSample, block, _file);
+			if (_bytesPerSample==1)
+				ConvertSamples8(dst + read, raw, got, _conversion);
+			else
+				ConvertSamples16(dst + read, (const short*)raw, got, _conversion);
+			read += got;
+
+			if (got < block)
+				break;
+		}
+	}
+	// Smoothing is inherently serial
+	if (_smoothingPeriod!=0)
+	{
+		for (int i=0; i<read; i++)
+			dst[i] = Smooth(dst[i], _rawSampleNumber + i);
+	}
+	_rawSampleNumber += read;
+
+	// Update position
+	if (read>0)
+	{
+		_currentSampleNumber += read;
+		_currentSample = dst[read-1];
+	}
+	if (read < requested)
+		_currentSample = EOF_SAMPLE;
+
+	return read;
+}
+
+// Convert a run of samples straight from the mapped data
+void CWaveReader::ConvertMappedSamples(int* dst, int64 sampleNumber, int count)
+{
+	const unsigned char* p = _data + sampleNumber * _bytesPerSample;
+	if (_bytesPerSample==1)
+		ConvertSamples8(dst, p, count, _conversion);
+	else
+		ConvertSamples16(dst, (const short*)p, count, _conversion);
+}
+
+// Get the translated (but unsmoothed) value of a mapped sample.  The first
+// sample never contributes to smoothing so it (and anything before it) reads as zero
+int CWaveReader::ConvertedSample(int64 sampleNumber)
+{
+	if (sampleNumber<1)
+		return 0;
+
+	const unsigned char* p = _data + sampleNumber * _bytesPerSample;
+	return ConvertSample(_bytesPerSample==1 ? p[0]-128 : *(const short*)p, _conversion);
+}
+
+// Get the sum of translated samples 1 through sampleNumber.  The running total
+// is only checkpointed every PREFIX_BLOCK_SIZE samples and recently used blocks
+// are expanded in a small cache.  Sums wrap at 32-bits so only the difference
+// between two prefix sums is meaningful
+unsigned int CWaveReader::PrefixSum(int64 sampleNumber)
+{
+	int block = (int)(sampleNumber / PREFIX_BLOCK_SIZE);
+	int slot = block % PREFIX_CACHE_BLOCKS;
+
+	if (_prefixCache==NULL)
+	{
+		int numBlocks = (int)(_waveEndInSamples / PREFIX_BLOCK_SIZE + 1);
+		_prefixCheckpoints = (unsigned int*)malloc(sizeof(unsigned int) * numBlocks);
+		_prefixCache = (unsigned int*)malloc(sizeof(unsigned int) * PREFIX_BLOCK_SIZE * PREFIX_CACHE_BLOCKS);
+		InvalidatePrefixSums();
+	}
+
+	unsigned int* sums = _prefixCache + slot * PREFIX_BLOCK_SIZE;
+	if (_prefixCacheTags[slot]!=block)
+	{
+		int samples[PREFIX_BLOCK_SIZE];
+
+		// Make sure we've checkpointed up to the start of this block
+		if (_prefixCheckpointCount==0)
+		{
+			_prefixCheckpoints[0] = 0;
+			_prefixCheckpointCount = 1;
+		}
+		while (_prefixCheckpointCount <= block)
+		{
+			int64 from = (int64)(_prefixCheckpointCount-1) * PREFIX_BLOCK_SIZE + 1;
+			ConvertMappedSamples(samples, from, PREFIX_BLOCK_SIZE);
+
+			unsigned int sum = _prefixCheckpoints[_prefixCheckpointCount-1];
+			for (int i=0; i<PREFIX_BLOCK_SIZE; i++)
+				sum += samples[i];
+			_prefixCheckpoints[_prefixCheckpointCount++] = sum;
+		}
+
+		// Expand the block
+		int64 start = (int64)block * PREFIX_BLOCK_SIZE;
+		int count = PREFIX_BLOCK_SIZE;
+		if (count > _waveEndInSamples - start)
+			count = (int)(_waveEndInSamples - start);
+		ConvertMappedSamples(samples, start, count);
+
+		unsigned int sum = _prefixCheckpoints[block];
+		sums[0] = sum;
+		for (int i=1; i<count; i++)
+		{
+			sum += samples[i];
+			sums[i] = sum;
+		}
+
+		_prefixCacheTags[slot] = block;
+	}
+
+	return sums[sampleNumber - (int64)block * PREFIX_BLOCK_SIZE];
+}
+
+// Discard prefix sums (eg: after the sample translation changes)
+void CWaveReader::InvalidatePrefixSums()
+{
+	_prefixCheckpointCount = 0;
+	for (int i=0; i<PREFIX_CACHE_BLOCKS; i++)
+		_prefixCacheTags[i] = -1;
+}
+
 int CWaveReader::ReadRawSample()
 {
-	if (_currentSampleNumber > _dataEndInSamples)
+	if (_rawSampleNumber >= _waveEndInSamples)
 		return EOF_SAMPLE;
 
+	// Streamed?
+	if (_streaming)
+	{
+		unsigned char raw[2];
+		if (ReadStreamSamples(raw, _rawSampleNumber, 1)==0)
+			return EOF_SAMPLE;
+		_rawSampleNumber++;
+
+		if (_bytesPerSample==1)
+			return raw[0]-128;
+		else
+			return *(const short*)raw;
+	}
+
+	// Mapped?
+	if (_data!=NULL)
+	{
+		const unsigned char* p = _data + _rawSampleNumber * _bytesPerSample;
+		_rawSampleNumber++;
+
+		if (_bytesPerSample==1)
+			return p[0]-128;
+		else
+			return *(const short*)p;
+	}
+
 	if (_bytesPerSample==1)
 	{
 		int i = fgetc(_file);
@@ -370,6 +940,7 @@ int CWaveReader::ReadRawSample()
 			return EOF_SAMPLE;
 		else
 		{
+			_rawSampleNumber++;
 			return i-128;
 		}
 	}
@@ -380,8 +951,370 @@ int CWaveReader::ReadRawSample()
 			return EOF_SAMPLE;
 		else
 		{
+			_rawSampleNumber++;
 			return s;
 		}
 	}
 }
 
+// Read from the stream into the ring buffer until it holds the specified sample,
+// discarding the oldest samples as required.  Returns false at the end of the stream.
+bool CWaveReader::FillStream(int64 sampleNumber)
+{
+	while (_ringEnd <= sampleNumber)
+	{
+		if (_streamEOF)
+			return false;
+
+		// About to wait on the input, so anything decoded so far should be seen
+		// now (line buffering alone isn't enough as the Windows CRT doesn't support it)
+		fflush(stdout);
+
+		// Read up to the end of the ring (or a block, whichever is less)
+		int64 offset = _ringEnd % _ringLength;
+		int64 block = _ringLength - offset;
+		if (block > SAMPLE_BLOCK_SIZE)
+			block = SAMPLE_BLOCK_SIZE;
+
+		int got = (int)fread(_ring + offset * _bytesPerSample, _bytesPerSample, (size_t)block, _file);
+		_ringEnd += got;
+		if (_ringEnd - _ringStart > _ringLength)
+			_ringStart = _ringEnd - _ringLength;
+
+		// Now we know how long it is
+		if (got < block)
+		{
+			_streamEOF = true;
+			if (_waveEndInSamples > _ringEnd)
+			{
+				_waveEndInSamples = _ringEnd;
+				_dataEndInSamples = _ringEnd;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Copy raw samples out of the stream's ring buffer, returns the number of samples
+// copied which will be less than count at the end of the stream.  Samples that
+// have already been discarded from the ring buffer can't be read.
+int CWaveReader::ReadStreamSamples(unsigned char* dst, int64 sampleNumber, int count)
+{
+	if (sampleNumber < _ringStart)
+	{
+		if (_streamWindowExceeded)
+			return 0;
+		_streamWindowExceeded = true;
+		fprintf(stderr, "\nCan't seek back to sample %lli, only the last %lli samples of the input stream are kept (use --streamwindow:N to keep more)\n",
+				sampleNumber, _ringLength);
+		return 0;
+	}
+
+	if (!FillStream(sampleNumber + count - 1) && _ringEnd - sampleNumber < count)
+		count = _ringEnd > sampleNumber ? (int)(_ringEnd - sampleNumber) : 0;
+
+	// Copy out, allowing for wrap around
+	int copied = 0;
+	while (copied < count)
+	{
+		int64 offset = (sampleNumber + copied) % _ringLength;
+		int n = count - copied;
+		if (n > _ringLength - offset)
+			n = (int)(_ringLength - offset);
+		memcpy(dst + copied * _bytesPerSample, _ring + offset * _bytesPerSample, n * _bytesPerSample);
+		copied += n;
+	}
+
+	return copied;
+}
+
+// Resample to 1/factor of the source sample rate (1 to turn off).  The
+// converted (and smoothed) source samples are low pass filtered by a windowed
+// sinc FIR so nothing above the new Nyquist frequency aliases, and only every
+// factor'th output of the filter is calculated.  Decimated sample n is centred
+// on source sample n * factor, so positions map back to the source exactly.
+void CWaveReader::SetDecimation(int factor)
+{
+	free(_decimationTaps);
+	free(_decimationBuffer);
+	_decimationTaps = NULL;
+	_decimationBuffer = NULL;
+	_decimationTapCount = 0;
+	_decimationBufferSize = 0;
+	_decimationBufferStart = 0;
+	_decimationBufferCount = 0;
+	_decimatedPosition = 0;
+	_decimatedSample = 0;
+
+	if (factor > MAX_DECIMATION)
+		factor = MAX_DECIMATION;
+	_decimation = 1;
+	if (factor<=1)
+	{
+		PrepareFilterChain();
+		return;
+	}
+
+	_decimationTapCount = DECIMATION_TAPS * factor + 1;
+	_decimationBufferSize = SAMPLE_BLOCK_SIZE * factor + _decimationTapCount;
+	_decimationTaps = (float*)malloc(_decimationTapCount * sizeof(float));
+	_decimationBuffer = (float*)malloc(_decimationBufferSize * sizeof(float));
+	if (_decimationTaps==NULL || _decimationBuffer==NULL)
+	{
+		SetDecimation(1);
+		return;
+	}
+
+	// Cut off at half the new Nyquist frequency, far above any tape tones but
+	// leaving room for the (Blackman window's) transition band
+	double cutoff = 0.25 / factor;
+	int half = _decimationTapCount / 2;
+	double taps[DECIMATION_TAPS * MAX_DECIMATION + 1];
+	double total = 0;
+	for (int i=0; i<_decimationTapCount; i++)
+	{
+		int n = i - half;
+		double sinc = n==0 ? 2 * cutoff : sin(2 * PI * cutoff * n) / (PI * n);
+		double window = 0.42 - 0.5 * cos(2 * PI * i / (_decimationTapCount - 1)) + 0.08 * cos(4 * PI * i / (_decimationTapCount - 1));
+		taps[i] = sinc * window;
+		total += taps[i];
+	}
+
+	// Unity gain
+	for (int i=0; i<_decimationTapCount; i++)
+		_decimationTaps[i] = (float)(taps[i] / total);
+
+	_decimation = factor;
+	SeekDecimated(_currentSampleNumber / factor);
+
+	// The filter chain's coefficients depend on the sample rate
+	PrepareFilterChain();
+}
+
+int CWaveReader::GetDecimation()
+{
+	return _decimation;
+}
+
+void CWaveReader::SeekDecimated(int64 sampleNumber)
+{
+	if (sampleNumber<0)
+		sampleNumber = 0;
+
+	int sample;
+	_decimatedPosition = sampleNumber;
+	_decimatedSample = FilterDecimated(&sample, sampleNumber, 1)==1 ? sample : EOF_SAMPLE;
+}
+
+// Read the next count decimated samples, see ReadSamples
+int CWaveReader::ReadDecimatedSamples(int* dst, int count)
+{
+	int read = 0;
+	while (read < count)
+	{
+		int block = count - read;
+		if (block > SAMPLE_BLOCK_SIZE)
+			block = SAMPLE_BLOCK_SIZE;
+
+		int got = FilterDecimated(dst + read, _decimatedPosition + 1, block);
+		read += got;
+		_decimatedPosition += got;
+
+		if (got < block)
+			break;
+	}
+
+	if (read>0)
+		_decimatedSample = dst[read-1];
+	if (read < count)
+		_decimatedSample = EOF_SAMPLE;
+
+	return read;
+}
+
+// Calculate count (no more than SAMPLE_BLOCK_SIZE) decimated samples starting
+// at first.  Returns the number calculated, less than count at the end of the file
+int CWaveReader::FilterDecimated(int* dst, int64 first, int count)
+{
+	int half = _decimationTapCount / 2;
+	FillDecimationBuffer(first * _decimation - half, (count - 1) * _decimation + _decimationTapCount);
+
+	// (A stream's length may only just have been found)
+	int64 total = GetTotalSamples();
+	if (first + count > total)
+		count = first < total ? (int)(total - first) : 0;
+
+	for (int i=0; i<count; i++)
+	{
+		const float* x = _decimationBuffer + i * _decimation;
+		float sum;
+		int j = 0;
+
+#ifdef DECIMATE_SSE2
+		__m128 acc = _mm_setzero_ps();
+		for (; j+4<=_decimationTapCount; j+=4)
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x+j), _mm_loadu_ps(_decimationTaps+j)));
+
+		float lanes[4];
+		_mm_storeu_ps(lanes, acc);
+		sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+		sum = 0;
+#endif
+
+		for (; j<_decimationTapCount; j++)
+			sum += x[j] * _decimationTaps[j];
+
+		dst[i] = (int)floor(sum + 0.5f);
+	}
+
+	return count;
+}
+
+// Make sure the decimation buffer holds count source samples starting at from.
+// Anything before the start or after the end of the file reads as silence.
+void CWaveReader::FillDecimationBuffer(int64 from, int count)
+{
+	// Keep whatever's already buffered from there on
+	int keep = 0;
+	int64 bufferEnd = _decimationBufferStart + _decimationBufferCount;
+	if (from >= _decimationBufferStart && from < bufferEnd)
+	{
+		keep = (int)(bufferEnd - from);
+		if (keep > count)
+			keep = count;
+		memmove(_decimationBuffer, _decimationBuffer + (from - _decimationBufferStart), keep * sizeof(float));
+	}
+	_decimationBufferStart = from;
+	_decimationBufferCount = keep;
+
+	int samples[SAMPLE_BLOCK_SIZE];
+	int64 next = from + keep;
+	while (_decimationBufferCount < count)
+	{
+		if (next < 0 || next >= _waveEndInSamples)
+		{
+			_decimationBuffer[_decimationBufferCount++] = 0;
+			next++;
+			continue;
+		}
+
+		// ReadSourceSamples always starts after the current sample, so the
+		// first sample has to be picked up by seeking to it
+		if (next==0)
+		{
+			SeekSource(0);
+			_decimationBuffer[_decimationBufferCount++] = (float)_currentSample;
+			next++;
+			continue;
+		}
+
+		if (_currentSampleNumber != next - 1)
+			SeekSource(next - 1);
+
+		int block = count - _decimationBufferCount;
+		if (block > SAMPLE_BLOCK_SIZE)
+			block = SAMPLE_BLOCK_SIZE;
+
+		int got = ReadSourceSamples(samples, block);
+		for (int i=0; i<got; i++)
+			_decimationBuffer[_decimationBufferCount++] = (float)samples[i];
+		next += got;
+
+		// Short read, the rest is past the end
+		if (got < block)
+		{
+			while (_decimationBufferCount < count)
+				_decimationBuffer[_decimationBufferCount++] = 0;
+		}
+	}
+}
+
+// Run samples through a chain of filters (see CFilterChain::Parse) after any
+// conversion, smoothing and decimation.  The chain's stages have state, so
+// seeking restarts the chain a short way before the target position to let
+// it settle, and the samples around a seek may differ very slightly from
+// those read straight through.
+bool CWaveReader::SetFilterChain(const char* spec)
+{
+	if (!_filterChain.Parse(spec))
+		return false;
+
+	return PrepareFilterChain();
+}
+
+// Hash of the filter chain's settings (0 if none)
+unsigned int CWaveReader::GetFilterChainHash()
+{
+	return _filterChain.GetHash();
+}
+
+// Work out the chain's coefficients for the current sample rate and restart it
+// at the current position
+bool CWaveReader::PrepareFilterChain()
+{
+	if (_filterChain.IsEmpty())
+		return true;
+
+	_filterChainValid = false;
+	if (!_filterChain.Prepare(GetSampleRate(), _bytesPerSample==1 ? 127 : 32767))
+	{
+		_filterChain.Clear();
+		return false;
+	}
+
+	SeekFiltered(UnfilteredPosition());
+	return true;
+}
+
+void CWaveReader::SeekFiltered(int64 sampleNumber)
+{
+	if (sampleNumber<0)
+		sampleNumber = 0;
+
+	// A short way ahead, just keep reading
+	int warmup = _filterChain.GetWarmup();
+	if (!_filterChainValid || sampleNumber < _filteredPosition || sampleNumber - _filteredPosition > warmup)
+	{
+		// Restart the chain and warm it up on the samples before the target
+		int64 start = sampleNumber - warmup;
+		if (start<0)
+			start = 0;
+
+		_filterChain.Reset();
+		_filterChainValid = false;
+		SeekUnfiltered(start);
+		_filteredPosition = start;
+		_filteredSample = UnfilteredSample();
+		if (_filteredSample==EOF_SAMPLE)
+			return;
+
+		_filterChain.Process(&_filteredSample, 1);
+		_filterChainValid = true;
+	}
+
+	int samples[SAMPLE_BLOCK_SIZE];
+	while (_filteredPosition < sampleNumber)
+	{
+		int64 skip = sampleNumber - _filteredPosition;
+		int block = skip > SAMPLE_BLOCK_SIZE ? SAMPLE_BLOCK_SIZE : (int)skip;
+		if (ReadFilteredSamples(samples, block) < block)
+			break;
+	}
+}
+
+// Read the next count samples through the filter chain, see ReadSamples
+int CWaveReader::ReadFilteredSamples(int* dst, int count)
+{
+	int read = ReadUnfilteredSamples(dst, count);
+	_filterChain.Process(dst, read);
+	_filteredPosition += read;
+
+	if (read>0)
+		_filteredSample = dst[read-1];
+	if (read < count)
+		_filteredSample = EOF_SAMPLE;
+
+	return read;
+}
@@ -4,6 +4,27 @@
 #ifndef __WAVEREADER_H
 #define __WAVEREADER_H
 
+#include "MappedFile.h"
+#include "SampleConverter.h"
+#include "FilterChain.h"
+
+// Convenient number of samples to fetch at a time with ReadSamples
+#define SAMPLE_BLOCK_SIZE	4096
+
+// Granularity of the prefix sums used to seek through smoothed data
+#define PREFIX_BLOCK_SIZE	4096
+#define PREFIX_CACHE_BLOCKS	8
+
+// Default number of seconds of a streamed input kept for seeking backwards
+#define DEFAULT_STREAM_WINDOW	30
+
+// Length of a streamed wave whose header doesn't give the data length
+#define STREAM_UNKNOWN_SAMPLES	0x3FFFFFFFFFFFFFFFLL
+
+// Largest supported decimation factor, and FIR taps per unit of decimation
+#define MAX_DECIMATION		16
+#define DECIMATION_TAPS		24
+
 // CWaveFileReader - reads audio data from a tape recording
 class CWaveReader
 {
@@ -14,10 +35,13 @@ public:
 	void Close();
 	int GetBytesPerSample();
 	int GetSampleRate();
-	int GetTotalSamples();
+	int64 GetTotalSamples();
 	const char* GetFileName();
 
 	bool OpenFile(const char* filename);
+	bool IsStreaming();
+	bool StreamWindowExceeded();
+	void SetStreamWindow(double seconds);
 
 	void SetDCOffset(int offset);
 	int GetDCOffset();
@@ -27,24 +51,59 @@ public:
 	int GetSmoothingPeriod();
 	void SetMakeSquareWave(bool square);
 	bool GetMakeSquareWave();
+	void SetDecimation(int factor);
+	int GetDecimation();
+	int GetSourceSampleRate();
+	int64 GetSourceTotalSamples();
+	bool SetFilterChain(const char* spec);
+	unsigned int GetFilterChainHash();
 
-
-	int CurrentPosition();
-	void SeekRaw(int sampleNumber);
-	void Seek(int sampleNumber);
+	int64 CurrentPosition();
+	void SeekRaw(int64 sampleNumber);
+	void Seek(int64 sampleNumber);
 
 	bool NextSample();
 	bool HaveSample();
 	int CurrentSample();
 	int ReadRawSample();
 	int ReadSample();
+	int ReadSamples(int* dst, int count);
+
+	void UpdateConversion();
+	int Smooth(int sample, int64 sampleNumber);
+	void ConvertMappedSamples(int* dst, int64 sampleNumber, int count);
+	int ConvertedSample(int64 sampleNumber);
+	unsigned int PrefixSum(int64 sampleNumber);
+	void InvalidatePrefixSums();
+	bool ReadHeaderBytes(int64 offset, void* buf, int length);
+	static bool IsRegularFile(const char* filename);
+	void CloseFile();
+	bool FillStream(int64 sampleNumber);
+	int ReadStreamSamples(unsigned char* dst, int64 sampleNumber, int count);
+	void SeekSource(int64 sampleNumber);
+	bool NextSourceSample();
+	int ReadSourceSamples(int* dst, int count);
+	void SeekDecimated(int64 sampleNumber);
+	int ReadDecimatedSamples(int* dst, int count);
+	int FilterDecimated(int* dst, int64 first, int count);
+	void FillDecimationBuffer(int64 from, int count);
+	bool PrepareFilterChain();
+	void SeekUnfiltered(int64 sampleNumber);
+	int ReadUnfilteredSamples(int* dst, int count);
+	int64 UnfilteredPosition();
+	int UnfilteredSample();
+	void SeekFiltered(int64 sampleNumber);
+	int ReadFilteredSamples(int* dst, int count);
 
 	FILE* _file;
-	int _waveOffsetInBytes;
-	int _waveEndInSamples;
-	int _dataStartInSamples;
-	int _dataEndInSamples;
-	int _currentSampleNumber;
+	CMappedFile _map;
+	const unsigned char* _data;
+	int64 _rawSampleNumber;
+	int64 _waveOffsetInBytes;
+	int64 _waveEndInSamples;
+	int64 _dataStartInSamples;
+	int64 _dataEndInSamples;
+	int64 _currentSampleNumber;
 	int _sampleRate;
 	int _bytesPerSample;
 	int _currentSample;
@@ -56,6 +115,44 @@ public:
 	int _dc_offset;
 	double _amplify;
 	bool _makeSquareWave;
+	SAMPLE_CONVERSION _conversion;
+	unsigned int* _prefixCheckpoints;
+	int _prefixCheckpointCount;
+	unsigned int* _prefixCache;
+	int _prefixCacheTags[PREFIX_CACHE_BLOCKS];
+
+	// Streamed input (stdin or a pipe) - the most recent samples are kept
+	// in a ring buffer, earlier ones can't be sought back to
+	bool _streaming;
+	double _streamWindow;
+	unsigned char* _streamHeader;
+	int _streamHeaderLength;
+	unsigned char* _ring;
+	int64 _ringLength;
+	int64 _ringStart;
+	int64 _ringEnd;
+	bool _streamEOF;
+	bool _streamWindowExceeded;
+
+	// Decimation (see SetDecimation).  When on, positions, the sample rate and
+	// the length are all in decimated samples, which are filtered from the
+	// converted source samples held in _decimationBuffer
+	int _decimation;
+	float* _decimationTaps;
+	int _decimationTapCount;
+	float* _decimationBuffer;
+	int _decimationBufferSize;
+	int64 _decimationBufferStart;
+	int _decimationBufferCount;
+	int64 _decimatedPosition;
+	int _decimatedSample;
+
+	// Filter chain (see SetFilterChain).  Applied last, after decimation, and
+	// only valid while reading forward from where it was last warmed up
+	CFilterChain _filterChain;
+	bool _filterChainValid;
+	int64 _filteredPosition;
+	int _filteredSample;
 };
 
 #endif	// __WAVEREADER_H
@@ -5,38 +5,112 @@
 
 #include "WaveWriter.h"
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#define dup _dup
+#define fdopen _fdopen
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
 CWaveWriter::CWaveWriter()
 {
 	_file = NULL;
 	_amplitude = 14000;
 	_square = false;
 	_lastSquareSample = 0;
+	_container = containerRiff;
+	_headerLength = 0;
+	_streaming = false;
+	_dataBytes = 0;
+	_buffer = NULL;
+	_bufferUsed = 0;
+	_templates = NULL;
+	_templateCount = 0;
+	_templatesAllocated = 0;
 }
 
 CWaveWriter::~CWaveWriter()
 {
 	Close();
+	ClearTemplates();
+	free(_templates);
+	free(_buffer);
 }
 
 
-// Create the wave file
+// Sony Wave64 chunk GUIDs
+static const unsigned char w64Riff[16] = { 'r','i','f','f', 0x2E,0x91,0xCF,0x11,0xA5,0xD6,0x28,0xDB,0x04,0xC1,0x00,0x00 };
+static const unsigned char w64Wave[16] = { 'w','a','v','e', 0xF3,0xAC,0xD3,0x11,0x8C,0xD1,0x00,0xC0,0x4F,0x8E,0xDB,0x8A };
+static const unsigned char w64Fmt[16]  = { 'f','m','t',' ', 0xF3,0xAC,0xD3,0x11,0x8C,0xD1,0x00,0xC0,0x4F,0x8E,0xDB,0x8A };
+static const unsigned char w64Data[16] = { 'd','a','t','a', 0xF3,0xAC,0xD3,0x11,0x8C,0xD1,0x00,0xC0,0x4F,0x8E,0xDB,0x8A };
+
+// Create the wave file.  The container is chosen by extension: .rf64 and .w64
+// produce RF64 and Wave64 files respectively (for output over 4GB), anything
+// else produces a standard RIFF wave file.
+//
+// A file name of "-" writes to stdout.  Output to stdout or anything else that
+// can't seek (eg: a named pipe) is streamed, with the header's lengths
+// marked as unknown since they can't be patched when the file is closed.
 bool CWaveWriter::Create(const char* fileName, int sampleRate, int sampleSize)
 {
+	// Templates are for the previous sample rate
+	ClearTemplates();
+
 	// Create the file
-	_file = fopen(fileName, "wb");
+	if (strcmp(fileName, "-")==0)
+	{
+		// Use a duplicate of stdout's handle so stdout itself can be redirected
+		// elsewhere for text output
+		fflush(stdout);
+		int fd = dup(fileno(stdout));
+#ifdef _WIN32
+		if (fd>=0)
+			_setmode(fd, _O_BINARY);
+#endif
+		_file = fd<0 ? NULL : fdopen(fd, "wb");
+		fileName = "stdout";
+	}
+	else
+	{
+		_file = fopen(fileName, "wb");
+	}
 	if (_file==NULL)
 	{
 	    fprintf(stderr, "Could not create '%s' - %s (%i)\n", fileName, strerror(errno), errno);
 		return false;
 	}
+	_streaming = fseek64(_file, 0, SEEK_CUR)!=0;
+	_dataBytes = 0;
+
+	// Work out the container
+	const char* ext = strrchr(fileName, '.');
+	_container = containerRiff;
+	if (ext!=NULL && _strcmpi(ext, ".rf64")==0)
+		_container = containerRF64;
+	else if (ext!=NULL && _strcmpi(ext, ".w64")==0)
+		_container = containerW64;
 
 	// Write the header
 	InitWaveHeader(sampleRate, sampleSize);
-	fwrite(&_waveHeader, sizeof(_waveHeader), 1, _file);
+	WriteHeader(_streaming ? WAVE_UNKNOWN_LENGTH : 0);
+
+	// Samples are collected in a buffer and written in large blocks
+	if (_buffer==NULL)
+		_buffer = (unsigned char*)malloc(WAVE_WRITER_BUFFER_SIZE);
+	_bufferUsed = 0;
 
 	return true;
 }
 
+// Check if the output can't be patched on close
+bool CWaveWriter::IsStreaming()
+{
+	return _streaming;
+}
+
 int CWaveWriter::GetSampleRate()
 {
 	return _waveHeader.sampleRate;
@@ -68,17 +142,24 @@ void CWaveWriter::Close()
 	if (_file==NULL)
 		return;
 
+	FlushBuffer();
+
 	// Work out how much data was written
-	fseek(_file, 0, SEEK_END);
-	int dataBytes = ftell(_file) - sizeof(WAVEHEADER);
+	int64 dataBytes = _dataBytes;
 
-	// Update the header info
-	_waveHeader.riffChunkSize += dataBytes;
-	_waveHeader.dataChunkSize += dataBytes;
+	// Wave64 chunks are 8-byte aligned
+	if (_container==containerW64 && (dataBytes & 7)!=0)
+	{
+		static const char pad[8] = { 0 };
+		fwrite(pad, 8 - (int)(dataBytes & 7), 1, _file);
+	}
 
 	// Seek back to start and rewrite the header
-	fseek(_file, 0, SEEK_SET);
-	fwrite(&_waveHeader, sizeof(_waveHeader), 1, _file);
+	if (!_streaming)
+	{
+		fseek64(_file, 0, SEEK_SET);
+		WriteHeader(dataBytes);
+	}
 
 	// Close the file and clean up
 	fclose(_file);
@@ -87,9 +168,99 @@ void CWaveWriter::Close()
 
 }
 
-int CWaveWriter::CurrentPosition()
+int64 CWaveWriter::CurrentPosition()
+{
+	return (_dataBytes + _bufferUsed) / (_waveHeader.bitsPerSample/8);
+}
+
+// Write out any buffered sample data
+void CWaveWriter::FlushBuffer()
+{
+	if (_bufferUsed==0)
+		return;
+
+	fwrite(_buffer, _bufferUsed, 1, _file);
+	_dataBytes += _bufferUsed;
+	_bufferUsed = 0;
+}
+
+// Write the file header for the selected container, given the data length.
+// WAVE_UNKNOWN_LENGTH sets all the lengths to their maximum value (all bits set)
+// which is how readers recognise a stream of unknown length.
+void CWaveWriter::WriteHeader(int64 dataBytes)
 {
-	return (ftell(_file) - sizeof(WAVEHEADER)) / (_waveHeader.bitsPerSample/8);
+	unsigned int fmtChunkID = _waveHeader.fmtChunkID;
+	const void* fmt = &_waveHeader.audioFormat;
+	int fmtLength = _waveHeader.fmtChunkSize;
+	bool unknown = dataBytes==WAVE_UNKNOWN_LENGTH;
+
+	switch (_container)
+	{
+		case containerRiff:
+		{
+			if (dataBytes > 0xFFFFFFFFLL - (int64)sizeof(WAVEHEADER))
+				fprintf(stderr, "\nWave file too large for RIFF format, use a .rf64 or .w64 output file\n");
+
+			WAVEHEADER header = _waveHeader;
+			header.riffChunkSize += (unsigned int)dataBytes;
+			header.dataChunkSize += (unsigned int)dataBytes;
+			if (unknown)
+			{
+				header.riffChunkSize = 0xFFFFFFFF;
+				header.dataChunkSize = 0xFFFFFFFF;
+			}
+			fwrite(&header, sizeof(header), 1, _file);
+			_headerLength = sizeof(header);
+			break;
+		}
+
+		case containerRF64:
+		{
+			// RIFF header with sizes deferred to the ds64 chunk
+			int64 riffSize = 4 + (8 + 28) + (8 + fmtLength) + 8 + dataBytes;
+			unsigned int minusOne = 0xFFFFFFFF;
+			unsigned int ds64Length = 28;
+			int64 sampleCount = dataBytes / (_waveHeader.bitsPerSample/8);
+			unsigned int tableLength = 0;
+			if (unknown)
+				riffSize = sampleCount = -1;
+			fwrite("RF64", 4, 1, _file);
+			fwrite(&minusOne, 4, 1, _file);
+			fwrite("WAVEds64", 8, 1, _file);
+			fwrite(&ds64Length, 4, 1, _file);
+			fwrite(&riffSize, 8, 1, _file);
+			fwrite(&dataBytes, 8, 1, _file);
+			fwrite(&sampleCount, 8, 1, _file);
+			fwrite(&tableLength, 4, 1, _file);
+			fwrite(&fmtChunkID, 4, 1, _file);
+			fwrite(&fmtLength, 4, 1, _file);
+			fwrite(fmt, fmtLength, 1, _file);
+			fwrite("data", 4, 1, _file);
+			fwrite(&minusOne, 4, 1, _file);
+			_headerLength = 12 + (8 + 28) + (8 + fmtLength) + 8;
+			break;
+		}
+
+		case containerW64:
+		{
+			// Sizes are 64-bit and include the 24 byte chunk header
+			int64 fmtSize = 24 + fmtLength;
+			int64 dataSize = 24 + dataBytes;
+			int64 riffSize = 40 + fmtSize + ((dataSize + 7) & ~7);
+			if (unknown)
+				riffSize = dataSize = -1;
+			fwrite(w64Riff, 16, 1, _file);
+			fwrite(&riffSize, 8, 1, _file);
+			fwrite(w64Wave, 16, 1, _file);
+			fwrite(w64Fmt, 16, 1, _file);
+			fwrite(&fmtSize, 8, 1, _file);
+			fwrite(fmt, fmtLength, 1, _file);
+			fwrite(w64Data, 16, 1, _file);
+			fwrite(&dataSize, 8, 1, _file);
+			_headerLength = 40 + (int)fmtSize + 24;
+			break;
+		}
+	}
 }
 
 void CWaveWriter::InitWaveHeader(int sampleRate, int sampleSize)
@@ -121,19 +292,73 @@ int CWaveWriter::SampleRate()
 
 void CWaveWriter::RenderSample(short sample)
 {
+	if (_bufferUsed + 2 > WAVE_WRITER_BUFFER_SIZE)
+		FlushBuffer();
+
 	if (_waveHeader.bitsPerSample==8)
 	{
-		char ch = (char)(sample + 128);
-		fwrite(&ch, sizeof(ch), 1, _file);	
+		_buffer[_bufferUsed++] = (unsigned char)(sample + 128);
 	}
 	else
 	{
-		fwrite(&sample, sizeof(sample), 1, _file);	
+		memcpy(_buffer + _bufferUsed, &sample, sizeof(sample));
+		_bufferUsed += sizeof(sample);
 	}
 
 	_lastSquareSample = sample;
 }
 
+// Render a block of samples, converting a buffer full at a time
+void CWaveWriter::RenderSamples(const short* samples, int count)
+{
+	if (count<=0)
+		return;
+
+	int bytesPerSample = _waveHeader.bitsPerSample/8;
+	while (count>0)
+	{
+		int room = (WAVE_WRITER_BUFFER_SIZE - _bufferUsed) / bytesPerSample;
+		if (room==0)
+		{
+			FlushBuffer();
+			continue;
+		}
+
+		int n = count < room ? count : room;
+		if (bytesPerSample==1)
+		{
+			unsigned char* p = _buffer + _bufferUsed;
+			for (int i=0; i<n; i++)
+				p[i] = (unsigned char)(samples[i] + 128);
+		}
+		else
+		{
+			memcpy(_buffer + _bufferUsed, samples, n * sizeof(short));
+		}
+
+		_bufferUsed += n * bytesPerSample;
+		_lastSquareSample = samples[n-1];
+		samples += n;
+		count -= n;
+	}
+}
+
+// As above, for samples as returned by CWaveReader::ReadSamples
+void CWaveWriter::RenderSamples(const int* samples, int count)
+{
+	short block[4096];
+	while (count>0)
+	{
+		int n = count < 4096 ? count : 4096;
+		for (int i=0; i<n; i++)
+			block[i] = (short)samples[i];
+
+		RenderSamples(block, n);
+		samples += n;
+		count -= n;
+	}
+}
+
 void CWaveWriter::RenderSquaredOffSample(short sample)
 {
 	// Make it square
@@ -154,18 +379,143 @@ void CWaveWriter::RenderSquaredOffSample(short sample)
 
 void CWaveWriter::RenderSilence(int samples)
 {
-	for (int i=0; i<samples; i++)
-		RenderSample(0);
+	if (samples<=0)
+		return;
+
+	// Silence is the same byte throughout (0x80 for 8-bit, 0x00 for 16-bit)
+	int bytesPerSample = _waveHeader.bitsPerSample/8;
+	unsigned char fill = bytesPerSample==1 ? 0x80 : 0x00;
+	int64 bytes = (int64)samples * bytesPerSample;
+	while (bytes>0)
+	{
+		if (_bufferUsed==WAVE_WRITER_BUFFER_SIZE)
+			FlushBuffer();
+
+		int n = WAVE_WRITER_BUFFER_SIZE - _bufferUsed;
+		if (n > bytes)
+			n = (int)bytes;
+
+		memset(_buffer + _bufferUsed, fill, n);
+		_bufferUsed += n;
+		bytes -= n;
+	}
+
+	_lastSquareSample = 0;
 }
 
 void CWaveWriter::RenderWave(int cycles, int samples)
 {
-	for (int i=0; i<samples; i++)
+	if (samples<=0)
+		return;
+
+	RenderTemplate(FindTemplate(shapeWave, cycles, samples));
+}
+
+// Render a single sine cycle pulse of pulseSamples, followed by silence
+// to make up the total number of samples.  Never squared off.
+void CWaveWriter::RenderPulse(int pulseSamples, int samples)
+{
+	if (samples<=0)
+		return;
+
+	RenderTemplate(FindTemplate(shapePulse, pulseSamples, samples));
+}
+
+void CWaveWriter::RenderTemplate(WAVE_TEMPLATE* t)
+{
+	if (t==NULL)
+		return;
+
+	for (int i=0; i<t->_leadingZeros; i++)
+		RenderSample(_lastSquareSample);
+
+	RenderSamples(t->_data + t->_leadingZeros, t->_samples - t->_leadingZeros);
+}
+
+// Find the template for a waveform, rendering it if this is the first time
+// it's been used
+WAVE_TEMPLATE* CWaveWriter::FindTemplate(WaveShape shape, int cycles, int samples)
+{
+	bool square = shape==shapeWave && _square;
+	for (int i=0; i<_templateCount; i++)
 	{
-		double in = 2.0*PI*cycles*i/samples;
-		double curve = sin(in);
-		RenderSquaredOffSample(short(curve * _amplitude));
+		WAVE_TEMPLATE* t = _templates + i;
+		if (t->_shape==shape && t->_cycles==cycles && t->_samples==samples &&
+			t->_amplitude==_amplitude && t->_square==square)
+			return t;
 	}
+
+	short* data = (short*)malloc(samples * sizeof(short));
+	if (data==NULL)
+		return NULL;
+
+	if (_templateCount==_templatesAllocated)
+	{
+		int allocated = _templatesAllocated==0 ? 16 : _templatesAllocated * 2;
+		WAVE_TEMPLATE* p = (WAVE_TEMPLATE*)realloc(_templates, allocated * sizeof(WAVE_TEMPLATE));
+		if (p==NULL)
+		{
+			free(data);
+			return NULL;
+		}
+		_templates = p;
+		_templatesAllocated = allocated;
+	}
+
+	WAVE_TEMPLATE* t = _templates + _templateCount++;
+	t->_shape = shape;
+	t->_cycles = cycles;
+	t->_samples = samples;
+	t->_amplitude = _amplitude;
+	t->_square = square;
+	t->_leadingZeros = 0;
+	t->_data = data;
+
+	if (shape==shapePulse)
+	{
+		// cycles is the length of the pulse
+		for (int i=0; i<samples; i++)
+			data[i] = i < cycles ? (short)(sin(2*PI*i/cycles) * _amplitude) : 0;
+	}
+	else
+	{
+		bool haveLast = false;
+		short last = 0;
+		for (int i=0; i<samples; i++)
+		{
+			double in = 2.0*PI*cycles*i/samples;
+			double curve = sin(in);
+			short sample = short(curve * _amplitude);
+
+			// Same as RenderSquaredOffSample
+			if (square)
+			{
+				if (sample==0)
+				{
+					if (!haveLast)
+						t->_leadingZeros++;
+					sample = last;
+				}
+				else
+				{
+					sample = sample < 0 ? -_amplitude : _amplitude;
+					haveLast = true;
+				}
+				last = sample;
+			}
+
+			data[i] = sample;
+		}
+	}
+
+	return t;
+}
+
+void CWaveWriter::ClearTemplates()
+{
+	for (int i=0; i<_templateCount; i++)
+		free(_templates[i]._data);
+	_templateCount = 0;
 }
 
 /*
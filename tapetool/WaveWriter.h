@@ -29,6 +29,41 @@ struct WAVEHEADER
 };
 #pragma pack()
 
+// Container formats CWaveWriter can produce
+enum WaveContainer
+{
+	containerRiff,		// Standard RIFF wave, limited to 4GB
+	containerRF64,		// EBU RF64
+	containerW64,		// Sony Wave64
+};
+
+
+// Data length written to the header of a stream that can't be patched on close
+#define WAVE_UNKNOWN_LENGTH			(-1LL)
+
+// Size of the buffer sample data is collected in before being written
+#define WAVE_WRITER_BUFFER_SIZE		(256 * 1024)
+
+// Kinds of waveform CWaveWriter caches pre-rendered templates of
+enum WaveShape
+{
+	shapeWave,			// RenderWave - 'cycles' sine cycles, squared off if required
+	shapePulse,			// RenderPulse - one sine cycle then silence
+};
+
+// A pre-rendered waveform.  For squared off waves, any zero samples before the
+// first non-zero sample depend on what was rendered previously, so they're
+// counted in _leadingZeros and filled in when the template is rendered.
+struct WAVE_TEMPLATE
+{
+	WaveShape	_shape;
+	int			_cycles;
+	int			_samples;
+	int			_amplitude;
+	bool		_square;
+	int			_leadingZeros;
+	short*		_data;
+};
 
 // Target for rendering a new tape recording - generates a wave file
 class CWaveWriter
@@ -40,11 +75,21 @@ public:
 	FILE* _file;
 	int _amplitude;
 	WAVEHEADER _waveHeader;
+	WaveContainer _container;
+	int _headerLength;
+	bool _streaming;
+	int64 _dataBytes;
 	bool _square;
 	short _lastSquareSample;
+	unsigned char* _buffer;
+	int _bufferUsed;
+	WAVE_TEMPLATE* _templates;
+	int _templateCount;
+	int _templatesAllocated;
 
 
 	bool Create(const char* fileName, int sampleRate, int sampleSize);
+	bool IsStreaming();
 	int GetSampleRate();
 	int GetSampleSize();
 
@@ -52,12 +97,20 @@ public:
 	void SetSquare(bool square);
 	int GetAmplitude();
 	void InitWaveHeader(int sampleRate, int sampleSize);
+	void WriteHeader(int64 dataBytes);
 	int SampleRate();
 	void RenderSample(short sample);
+	void RenderSamples(const short* samples, int count);
+	void RenderSamples(const int* samples, int count);
 	void RenderSquaredOffSample(short sample);
 	void RenderSilence(int samples);
 	void RenderWave(int cycles, int samples);
-	int CurrentPosition();
+	void RenderPulse(int pulseSamples, int samples);
+	void RenderTemplate(WAVE_TEMPLATE* t);
+	WAVE_TEMPLATE* FindTemplate(WaveShape shape, int cycles, int samples);
+	void ClearTemplates();
+	int64 CurrentPosition();
+	void FlushBuffer();
 	
 	virtual void Close();
 	virtual Resolution GetProfiledResolution() { return resNA; };
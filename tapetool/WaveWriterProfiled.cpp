@@ -8,7 +8,6 @@
 
 CWaveWriterProfiled::CWaveWriterProfiled()
 {
-	_allocatedEntries = 0;
 	_firstSpan = NULL;
 	_currentSpan = NULL;
 	_currentSampleNumber = 0;
@@ -108,22 +107,12 @@ void CWaveWriterProfiled::AddRenderEntry(int speed, char kind)
 	// Start a new span?
 	if (_currentSpan == NULL || speed!=_currentSpan->_speed)
 	{
-		_currentSpan = new CSpan(_currentSpan, speed);
+		_currentSpan = new CSpan(_currentSpan, speed, _instrumentation.GetPackedBitsPerEntry());
 		if (_firstSpan==NULL)
 			_firstSpan = _currentSpan;
-
-		_allocatedEntries = 1024;
-		_currentSpan->_entries = (char*)malloc(1024 * sizeof(char));
-	}
-
-	// Allocate more storage?
-	if (_currentSpan->_length + 1 >= _allocatedEntries)
-	{
-		_allocatedEntries*=2;
-		_currentSpan->_entries = (char*)realloc(_currentSpan->_entries, _allocatedEntries);
 	}
 
-	_currentSpan->_entries[_currentSpan->_length++] = kind;
+	_currentSpan->_entries.Add(_instrumentation.PackKind(kind));
 	_totalEntries++;
 }
 
@@ -138,28 +127,42 @@ void CWaveWriterProfiled::RenderProfiledBit(int speed, int bit)
 	AddRenderEntry(speed, (char)bit);
 }
 
-void CWaveWriterProfiled::CopySamples(int offset, int count, const char* type, int entries)
+void CWaveWriterProfiled::CopySamples(int64 offset, int64 count, const char* type, int entries)
 {
 	_slices++;
-	printf("%4i %-10s %10i %10i %10i to %10i -> %10i to %10i %3i\n", _slices, type, count, entries, offset, offset + count, _currentSampleNumber, _currentSampleNumber+count, _entriesMatched * 100 / _totalEntries);
+	printf("%4i %-10s %10lli %10i %10lli to %10lli -> %10lli to %10lli %3i\n", _slices, type, count, entries, offset, offset + count, _currentSampleNumber, _currentSampleNumber+count, _entriesMatched * 100 / _totalEntries);
 
 	_wave.Seek(offset);
 
-	if (_timeSync)
+	// Copy a block at a time
+	int samples[SAMPLE_BLOCK_SIZE];
+	samples[0] = _wave.CurrentSample();
+	int available = _wave.HaveSample() ? 1 : 0;
+	int64 remaining = count;
+	while (remaining>0 && available>0)
 	{
-		for (int i=0; i<count; i++)
+		int n = available < remaining ? available : (int)remaining;
+		if (_timeSync)
 		{
-			_timeSync->AddSample(_wave.CurrentSample());
-			_wave.NextSample();
+			for (int i=0; i<n; i++)
+				_timeSync->AddSample(samples[i]);
+		}
+		else
+		{
+			CWaveWriter::RenderSamples(samples, n);
 		}
+		remaining -= n;
+		if (remaining>0)
+			available = _wave.ReadSamples(samples, SAMPLE_BLOCK_SIZE);
 	}
-	else
+
+	// Past the end of the input file
+	for (int64 i=0; i<remaining; i++)
 	{
-		for (int i=0; i<count; i++)
-		{
+		if (_timeSync)
+			_timeSync->AddSample(_wave.CurrentSample());
+		else
 			CWaveWriter::RenderSample(_wave.CurrentSample());
-			_wave.NextSample();
-		}
 	}
 
 	_currentSampleNumber += count;
@@ -200,14 +203,15 @@ bool CWaveWriterProfiled::Flush()
 	// So by now we should have a full list of rendered bits that we can try to match up with the instrumentation
 	for (CSpan* s = _firstSpan; s!=NULL; s=s->_next)
 	{
+		int spanLength = (int)s->_entries.GetLength();
 		int pos = 0;
-		while (pos < s->_length)
+		while (pos < spanLength)
 		{
 			// Find matching sequence.  If we're not at the start, start one sample before
 			INSTR_ENTRY* e;
 			int matchLength;
 			int searchPos = pos == 0 ? 0 : pos-1;
-			if (!_instrumentation.FindSequence(s->_speed, s->_entries + searchPos, s->_length - searchPos, &e, &matchLength))
+			if (!_instrumentation.FindSequence(s->_speed, s->_entries, searchPos, spanLength - searchPos, &e, &matchLength))
 			{
 				fprintf(stderr, "Failed to find matching patten in profiled file, aborting\n");
 				return false;
@@ -220,18 +224,16 @@ bool CWaveWriterProfiled::Flush()
 				e++;
 			}
 
-//			printf("needed: '%c' found '%c'\n", s->_entries[pos + matchLength], e[matchLength]._kind);
-
 			// Unless we matched the whole thing, don't include the last bit
-			if (pos + matchLength < s->_length)
+			if (pos + matchLength < spanLength)
 			{
 				matchLength--;
 			}
 
 			// Work out the sample range to copy
-			int startSample = e->_offset;
-			int endSample = (e+matchLength)->_offset;
-			int samples = endSample - startSample;
+			int64 startSample = e->_offset;
+			int64 endSample = (e+matchLength)->_offset;
+			int64 samples = endSample - startSample;
 
 			_entriesMatched += matchLength;
 
@@ -265,8 +267,8 @@ bool CWaveWriterProfiled::Flush()
 	// Copy trailing samples
 	if (IncludeLeadOut)
 	{
-		int trailingOffset = _instrumentation.TrailingSamplesOffset();
-		int trailingSamples = _wave.GetTotalSamples() - trailingOffset;
+		int64 trailingOffset = _instrumentation.TrailingSamplesOffset();
+		int64 trailingSamples = _wave.GetTotalSamples() - trailingOffset;
 		CopySamples(trailingOffset, trailingSamples, "lead-out", 0);
 		if (_timeSync)
 		{
@@ -7,6 +7,7 @@
 #include "TapeReader.h"
 #include "WaveWriter.h"
 #include "Instrumentation.h"
+#include "PackedArray.h"
 
 class CTimeSynchronizer;
 
@@ -30,45 +31,39 @@ public:
 	bool IncludeLeadIn;
 	bool IncludeLeadOut;
 
-	void CopySamples(int offset, int count, const char* type, int entries);
+	void CopySamples(int64 offset, int64 count, const char* type, int entries);
 
 	class CSpan
 	{
 	public:
-		CSpan(CSpan* prev, int speed)
+		CSpan(CSpan* prev, int speed, int bitsPerEntry) : _entries(bitsPerEntry)
 		{
 			if (prev!=NULL)
 				prev->_next = this;
-			_length = 0;
 			_speed = speed;
-			_entries = NULL;
 			_next = NULL;
 		}
 
 		~CSpan()
 		{
-			if (_entries!=NULL)
-				free(_entries);
 			if (_next!=NULL)
 				delete _next;
 		}
 
-		int _length;
 		int _speed;
-		char* _entries;
+		CPackedArray _entries;		// packed the same as the instrumentation's kinds
 		CSpan* _next;
 	};
 
 
 	CWaveReader _wave;
 	CInstrumentation _instrumentation;
-	int _allocatedEntries;
 	int _totalEntries;
 	int _entriesMatched;
 	int _slices;
 	CSpan* _firstSpan;
 	CSpan* _currentSpan;
-	int _currentSampleNumber;
+	int64 _currentSampleNumber;
 	double _cycleLengths[127];
 	double _bitLengths[16];
 	CTimeSynchronizer* _timeSync;
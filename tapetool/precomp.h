@@ -4,6 +4,11 @@
 #ifndef __PRECOMP_H
 #define __PRECOMP_H
 
+// Large file support for stdio on posix systems
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,6 +18,19 @@
 #define PI 3.1415926535897932384626433832795
 #define EOF_SAMPLE	0x7FFFFFFF
 
+// Sample positions and file offsets (long captures can exceed 2^31 samples)
+typedef long long int64;
+
+#ifdef _MSC_VER
+#define fseek64	_fseeki64
+#define ftell64	_ftelli64
+#define atoi64	_atoi64
+#else
+#define fseek64	fseeko
+#define ftell64	ftello
+#define atoi64	atoll
+#endif
+
 
 #endif	// __PRECOMP_H
 